@@ -0,0 +1,189 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <cstdlib>
+#include <new>
+
+#include "../final/threadpool.h"
+
+/*
+统计每次提交任务时提交线程上发生的堆内存分配次数
+对比原来的 make_shared<packaged_task> + bind + function<void()> 打包方式，
+和现在 submitTask 使用的内联存储任务对象
+submitTask 的共享状态从线程池的内存池分配，结果取走后回收，稳定运行时也不再分配；
+post 不创建共享状态
+*/
+
+// 只统计当前线程的分配次数，线程池工作线程的分配不计入
+thread_local size_t allocCount = 0;
+
+// 替换的new和delete不内联：内联后编译器看到的是malloc和operator delete、operator new和free配对，
+// 会误报-Wmismatched-new-delete
+#if defined(__GNUC__)
+#define ALLOC_NOINLINE __attribute__((noinline))
+#else
+#define ALLOC_NOINLINE
+#endif
+
+ALLOC_NOINLINE void* operator new(size_t size)
+{
+	allocCount++;
+	if (void* p = std::malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+// 按缓存行对齐的对象（无锁队列的槽位、工作窃取队列等）走对齐的版本，同样计数
+ALLOC_NOINLINE void* operator new(size_t size, std::align_val_t align)
+{
+	allocCount++;
+	size_t alignment = (size_t)align;
+	// aligned_alloc要求大小是对齐的整数倍
+	if (void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+ALLOC_NOINLINE void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+ALLOC_NOINLINE void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+ALLOC_NOINLINE void operator delete(void* p, std::align_val_t) noexcept
+{
+	std::free(p);
+}
+
+ALLOC_NOINLINE void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	std::free(p);
+}
+
+const int SUBMIT_COUNT = 100000;
+const size_t SUBMIT_WINDOW = 256;	// submitTask每提交这么多任务取一次结果
+
+int sum(int a, int b)
+{
+	return a + b;
+}
+
+// 原来的打包方式，任务放进 std::queue 再取出执行
+double legacySubmit()
+{
+	std::queue<std::function<void()>> que;
+	std::vector<std::future<int>> results;
+	results.reserve(SUBMIT_COUNT);
+
+	size_t before = allocCount;
+	for (int i = 0; i < SUBMIT_COUNT; i++)
+	{
+		auto task = std::make_shared<std::packaged_task<int()>>(
+			std::bind(sum, i, 1)
+		);
+		results.emplace_back(task->get_future());
+		que.emplace([task](){ (*task)(); });
+	}
+	size_t count = allocCount - before;
+
+	while (!que.empty())
+	{
+		que.front()();
+		que.pop();
+	}
+	return (double)count / SUBMIT_COUNT;
+}
+
+// 通过线程池 submitTask 提交，每提交SUBMIT_WINDOW个任务取一次结果，
+// 先跑一轮预热，让共享状态的内存池里有可以复用的内存块
+double poolSubmit(TaskQueType type)
+{
+	ThreadPool pool;
+	pool.setTaskQueType(type);
+	pool.setTaskQueMaxThreshHold(SUBMIT_COUNT);
+	pool.start(2);
+
+	std::vector<std::future<int>> results;
+	results.reserve(SUBMIT_WINDOW);
+
+	size_t count = 0;
+	for (int round = 0; round < 2; round++)
+	{
+		size_t before = allocCount;
+		for (int i = 0; i < SUBMIT_COUNT; i++)
+		{
+			results.emplace_back(pool.submitTask(sum, i, 1));
+			if (results.size() == SUBMIT_WINDOW)
+			{
+				for (auto &res : results)
+				{
+					res.get();
+				}
+				results.clear();
+			}
+		}
+		count = allocCount - before;
+	}
+	return (double)count / SUBMIT_COUNT;
+}
+
+// 通过线程池 post 提交，不需要结果
+double poolPost(TaskQueType type)
+{
+	ThreadPool pool;
+	pool.setTaskQueType(type);
+	pool.setTaskQueMaxThreshHold(SUBMIT_COUNT);
+	pool.start(2);
+
+	std::atomic_int done(0);
+	size_t before = allocCount;
+	for (int i = 0; i < SUBMIT_COUNT; i++)
+	{
+		pool.post([&done]() { done++; });
+	}
+	size_t count = allocCount - before;
+
+	while (done < SUBMIT_COUNT)
+		std::this_thread::yield();
+	return (double)count / SUBMIT_COUNT;
+}
+
+// 不需要返回值的小lambda直接构造任务对象
+double taskObject()
+{
+	int counter = 0;
+	size_t before = allocCount;
+	for (int i = 0; i < SUBMIT_COUNT; i++)
+	{
+		InplaceTask task([&counter, i]() { counter += i; });
+		task();
+	}
+	return (double)(allocCount - before) / SUBMIT_COUNT;
+}
+
+int main()
+{
+	double legacy = legacySubmit();
+	double locked = poolSubmit(TaskQueType::QUEUE_LOCKED);
+	double lockfree = poolSubmit(TaskQueType::QUEUE_LOCKFREE);
+	double postLocked = poolPost(TaskQueType::QUEUE_LOCKED);
+	double postLockfree = poolPost(TaskQueType::QUEUE_LOCKFREE);
+	double inplace = taskObject();
+
+	std::cout << "allocations per submit" << std::endl;
+	std::cout << "packaged_task + bind + function : " << legacy << std::endl;
+	std::cout << "submitTask, locked queue         : " << locked << std::endl;
+	std::cout << "submitTask, lock-free queue      : " << lockfree << std::endl;
+	std::cout << "post, locked queue               : " << postLocked << std::endl;
+	std::cout << "post, lock-free queue            : " << postLockfree << std::endl;
+	std::cout << "InplaceTask, small lambda        : " << inplace << std::endl;
+	return 0;
+}
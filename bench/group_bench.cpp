@@ -0,0 +1,89 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "../final/threadpool.h"
+
+/*
+一个租户压满线程池时，另一个租户的排队延迟（提交到开始执行）
+对比所有租户共用一个先进先出队列，和每个租户一个分组、按权重轮转出队的队列
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const int NOISY_COUNT = 4000;							// 吵闹租户一次性提交的任务数量
+const auto TASK_COST = std::chrono::microseconds(200);	// 每个任务的执行时间
+const int QUIET_COUNT = 100;							// 安静租户的任务数量
+const auto QUIET_INTERVAL = std::chrono::milliseconds(5);
+
+// 忙等一段时间，模拟计算任务
+void spin(Clock::duration cost)
+{
+	auto end = Clock::now() + cost;
+	while (Clock::now() < end)
+	{
+	}
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+	return values[index];
+}
+
+void runCase(const char* name, TaskQueType type)
+{
+	ThreadPool pool;
+	pool.setTaskQueType(type);
+	pool.setTaskQueMaxThreshHold(NOISY_COUNT + QUIET_COUNT);
+	TenantGroup noisy = pool.addTenantGroup("noisy");
+	TenantGroup quiet = pool.addTenantGroup("quiet");
+	pool.start(2);
+
+	std::vector<std::future<void>> bulk;
+	for (int i = 0; i < NOISY_COUNT; i++)
+	{
+		bulk.emplace_back(pool.submitTask(noisy, spin, TASK_COST));
+	}
+
+	// 安静租户的每个任务记录从提交到开始执行的时间
+	std::vector<double> latency(QUIET_COUNT);
+	std::vector<std::future<void>> probes;
+	for (int i = 0; i < QUIET_COUNT; i++)
+	{
+		auto submitTime = Clock::now();
+		probes.emplace_back(pool.submitTask(quiet, [&latency, i, submitTime]() {
+			latency[i] = std::chrono::duration<double, std::micro>(Clock::now() - submitTime).count();
+			spin(TASK_COST);
+		}));
+		std::this_thread::sleep_for(QUIET_INTERVAL);
+	}
+	for (auto &f : probes)
+		f.get();
+	for (auto &f : bulk)
+		f.get();
+
+	std::cout << name << " quiet tenant latency us: p50 " << percentile(latency, 0.5)
+		<< ", p99 " << percentile(latency, 0.99)
+		<< ", max " << percentile(latency, 1.0) << std::endl;
+
+	// 分组队列还能从统计中看到每个分组各自的排队时间
+	PoolStats stats = pool.getStats();
+	for (auto &group : stats.groups_)
+	{
+		if (group.dequeued_ == 0)
+			continue;
+		std::cout << "    group " << group.name_ << ": dequeued " << group.dequeued_
+			<< ", queue wait p99 us " << group.queueWait_.percentile(99) / 1000.0 << std::endl;
+	}
+}
+
+int main()
+{
+	runCase("fifo   ", TaskQueType::QUEUE_LOCKED);
+	runCase("grouped", TaskQueType::QUEUE_GROUPED);
+	return 0;
+}
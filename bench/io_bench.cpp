@@ -0,0 +1,163 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <future>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../final/threadpool.h"
+
+/*
+大量连接上的回显吞吐
+对比每个连接一个任务循环阻塞读（每个连接占住一个工作线程，线程数量必须不少于连接数量），
+和submitOnReadable等待可读（少量线程服务所有连接）。连接是本地的socketpair，
+驱动线程每一轮给所有连接各写一个字节，再读回所有的回显
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const int CONNECTION_COUNT = 64;	// 连接数量
+const int ROUND_COUNT = 2000;		// 每个连接的往返次数
+const int REACTOR_THREADS = 4;		// submitOnReadable方式的工作线程数量
+
+struct Connection
+{
+	int client_;	// 驱动线程这一端
+	int server_;	// 线程池这一端
+};
+
+std::vector<Connection> openConnections()
+{
+	std::vector<Connection> conns(CONNECTION_COUNT);
+	for (auto &conn : conns)
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		{
+			perror("socketpair");
+			exit(1);
+		}
+		conn.client_ = fds[0];
+		conn.server_ = fds[1];
+	}
+	return conns;
+}
+
+// 每一轮给所有连接写一个字节，再读回所有回显，返回每秒的消息数量
+double drive(std::vector<Connection>& conns)
+{
+	auto start = Clock::now();
+	for (int round = 0; round < ROUND_COUNT; round++)
+	{
+		char c = (char)round;
+		for (auto &conn : conns)
+		{
+			if (write(conn.client_, &c, 1) != 1)
+				exit(1);
+		}
+		for (auto &conn : conns)
+		{
+			char reply;
+			if (read(conn.client_, &reply, 1) != 1 || reply != c)
+				exit(1);
+		}
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return (double)CONNECTION_COUNT * ROUND_COUNT / seconds;
+}
+
+// 关闭客户端一端，服务端读到0结束
+void closeClients(std::vector<Connection>& conns)
+{
+	for (auto &conn : conns)
+	{
+		close(conn.client_);
+	}
+}
+
+void closeServers(std::vector<Connection>& conns)
+{
+	for (auto &conn : conns)
+	{
+		close(conn.server_);
+	}
+}
+
+// 每个连接一个任务循环阻塞读
+void runBlocking()
+{
+	auto conns = openConnections();
+	ThreadPool pool;
+	pool.setTaskQueMaxThreshHold(CONNECTION_COUNT);
+	pool.start(CONNECTION_COUNT);
+
+	std::vector<std::future<void>> results;
+	for (auto &conn : conns)
+	{
+		int fd = conn.server_;
+		results.emplace_back(pool.submitTask([fd]() {
+			char buf[64];
+			ssize_t n;
+			while ((n = read(fd, buf, sizeof(buf))) > 0)
+			{
+				if (write(fd, buf, n) != n)
+					return;
+			}
+		}));
+	}
+	double rate = drive(conns);
+	closeClients(conns);
+	for (auto &f : results)
+		f.get();
+	closeServers(conns);
+	std::cout << "blocking read    " << CONNECTION_COUNT << " threads: " << rate << " msg/s" << std::endl;
+}
+
+// 可读时回显，再次等待可读
+struct Echo
+{
+	ThreadPool* pool_;
+	int fd_;
+
+	void operator()() const
+	{
+		char buf[64];
+		ssize_t n = read(fd_, buf, sizeof(buf));
+		if (n <= 0)
+			return;
+		// 先重新等待再回显，驱动线程读到回显时下一次等待已经注册
+		pool_->submitOnReadable(fd_, *this);
+		if (write(fd_, buf, n) != n)
+			return;
+	}
+};
+
+void runReactor()
+{
+	auto conns = openConnections();
+	ThreadPool pool;
+	pool.setTaskQueMaxThreshHold(CONNECTION_COUNT * 2);
+	pool.start(REACTOR_THREADS);
+
+	for (auto &conn : conns)
+	{
+		pool.submitOnReadable(conn.server_, Echo{ &pool, conn.server_ });
+	}
+	double rate = drive(conns);
+	// 每个回显任务都在回显之前重新等待，所有回显读完之后每个连接上都有一个等待中的任务
+	for (auto &conn : conns)
+	{
+		pool.cancelIo(conn.server_);
+	}
+	closeClients(conns);
+	closeServers(conns);
+	std::cout << "submitOnReadable " << REACTOR_THREADS << " threads: " << rate << " msg/s" << std::endl;
+}
+
+int main()
+{
+	runBlocking();
+	runReactor();
+	return 0;
+}
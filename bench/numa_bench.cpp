@@ -0,0 +1,95 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "../final/threadpool.h"
+
+/*
+内存带宽受限任务在不同绑定方式下的吞吐量
+每个NUMA节点一个生产者线程，绑定在该节点上，先写一遍自己的缓冲区（首次写入决定内存所在节点），
+再提交对这些缓冲区求和的任务。按节点分队列并绑定线程时，任务优先由与内存同一节点的线程执行。
+单节点机器上各种方式的差别只有绑定本身的影响
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const size_t BUFFER_WORDS = 1 << 19;	// 每个缓冲区4MB，超过一般的L2缓存
+const int BUFFERS_PER_NODE = 16;		// 每个生产者的缓冲区数量
+const int ROUNDS = 8;					// 每个缓冲区被求和的次数
+
+uint64_t sumBuffer(const uint64_t* data)
+{
+	uint64_t sum = 0;
+	for (size_t i = 0; i < BUFFER_WORDS; i++)
+	{
+		sum += data[i];
+	}
+	return sum;
+}
+
+void runCase(const char* name, AffinityPolicy policy, const CpuTopology& topology)
+{
+	ThreadPool pool;
+	pool.setMode(PoolMode::MODE_STEALING);
+	pool.setTaskQueMaxThreshHold(topology.nodeCount() * BUFFERS_PER_NODE * ROUNDS);
+	pool.setCpuTopology(topology);
+	pool.setAffinity(policy);
+	pool.start(topology.cpus().size());
+
+	int nodes = topology.nodeCount();
+	std::vector<std::vector<std::unique_ptr<uint64_t[]>>> buffers(nodes);
+	std::vector<std::vector<std::future<uint64_t>>> results(nodes);
+	std::vector<std::thread> producers;
+	std::atomic_int ready(0);
+	std::atomic_bool go(false);
+	for (int node = 0; node < nodes; node++)
+	{
+		producers.emplace_back([&, node]() {
+			CpuTopology::pinCurrentThread(topology.cpusOfNode(node));
+			for (int b = 0; b < BUFFERS_PER_NODE; b++)
+			{
+				buffers[node].emplace_back(new uint64_t[BUFFER_WORDS]);
+				uint64_t* data = buffers[node].back().get();
+				for (size_t i = 0; i < BUFFER_WORDS; i++)
+					data[i] = i;
+			}
+			ready++;
+			while (!go)
+				std::this_thread::yield();
+			for (int r = 0; r < ROUNDS; r++)
+			{
+				for (auto &buffer : buffers[node])
+					results[node].emplace_back(pool.submitTask(sumBuffer, buffer.get()));
+			}
+		});
+	}
+	while (ready < nodes)
+		std::this_thread::yield();
+
+	auto begin = Clock::now();
+	go = true;
+	for (auto &t : producers)
+		t.join();
+	for (auto &rs : results)
+	{
+		for (auto &f : rs)
+			f.get();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+	double bytes = (double)nodes * BUFFERS_PER_NODE * ROUNDS * BUFFER_WORDS * sizeof(uint64_t);
+	std::cout << name << " " << nodes << " nodes, " << topology.cpus().size() << " cpus: "
+		<< bytes / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+int main()
+{
+	CpuTopology topology = CpuTopology::detect();
+	runCase("none", AffinityPolicy::AFFINITY_NONE, topology);
+	runCase("core", AffinityPolicy::AFFINITY_CORE, topology);
+	runCase("node", AffinityPolicy::AFFINITY_NODE, topology);
+	return 0;
+}
@@ -0,0 +1,250 @@
+#ifndef POOL_BENCH_H
+#define POOL_BENCH_H
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+/*
+线程池基准测试的公共部分
+两种线程池的类名相同，不能链接进同一个程序，所以各自编译一个程序，
+通过Adapter适配提交和等待任务的接口，测试用例在这里只写一份。
+结果按CSV输出到标准输出，每行一个指标：impl,mode,benchmark,producers,metric,value,unit
+
+Adapter需要提供：
+	using Handle = ...;							// 提交任务返回的结果对象
+	Adapter(PoolMode mode, int threads);		// 设置模式并启动线程池
+	template<typename Func> Handle submit(Func func);
+	static void wait(Handle& handle);
+	int threadSize() const;
+*/
+
+using BenchClock = std::chrono::steady_clock;
+
+const int THROUGHPUT_TASKS = 200000;	// 吞吐量测试提交的空任务数量
+const int LATENCY_SAMPLES = 2000;		// 延迟测试的采样数量
+const int FANOUT_WIDTH = 1000;			// 每轮扇出的任务数量
+const int FANOUT_ROUNDS = 20;			// 扇出扇入的轮数
+const int CONTENTION_TASKS = 100000;	// 多生产者测试提交的任务总数
+const int CACHED_MAX_THREADS = 64;		// cached模式的线程上限，两种线程池保持一致
+const auto SPAWN_TIMEOUT = std::chrono::seconds(5);
+
+inline double elapsedUs(BenchClock::time_point begin, BenchClock::time_point end)
+{
+	return std::chrono::duration<double, std::micro>(end - begin).count();
+}
+
+inline double benchPercentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+	return values[index];
+}
+
+// 测试用的线程数量，至少2个
+inline int benchThreads()
+{
+	return std::max(2, (int)std::thread::hardware_concurrency());
+}
+
+/// <summary>
+/// 输出一行CSV结果
+/// </summary>
+class BenchReport
+{
+public:
+	BenchReport(const char* impl, const char* mode)
+		: impl_(impl), mode_(mode)
+	{}
+
+	static void header()
+	{
+		std::cout << "impl,mode,benchmark,producers,metric,value,unit" << std::endl;
+	}
+
+	void row(const char* benchmark, int producers, const char* metric, double value, const char* unit) const
+	{
+		std::cout << impl_ << "," << mode_ << "," << benchmark << "," << producers << ","
+				  << metric << "," << value << "," << unit << std::endl;
+	}
+
+private:
+	std::string impl_;
+	std::string mode_;
+};
+
+// 单个生产者提交空任务的吞吐量，从第一次提交到全部完成
+template<typename Adapter>
+void benchThroughput(const BenchReport& report, PoolMode mode)
+{
+	Adapter pool(mode, benchThreads());
+	std::vector<typename Adapter::Handle> handles;
+	handles.reserve(THROUGHPUT_TASKS);
+
+	auto begin = BenchClock::now();
+	for (int i = 0; i < THROUGHPUT_TASKS; i++)
+	{
+		handles.emplace_back(pool.submit([]() {}));
+	}
+	auto submitted = BenchClock::now();
+	for (auto &h : handles)
+	{
+		Adapter::wait(h);
+	}
+	auto end = BenchClock::now();
+
+	report.row("throughput", 1, "submit_rate", THROUGHPUT_TASKS / elapsedUs(begin, submitted) * 1e6, "tasks/s");
+	report.row("throughput", 1, "complete_rate", THROUGHPUT_TASKS / elapsedUs(begin, end) * 1e6, "tasks/s");
+}
+
+// 线程池空闲时提交一个任务，到任务开始执行的延迟
+template<typename Adapter>
+void benchLatency(const BenchReport& report, PoolMode mode)
+{
+	Adapter pool(mode, benchThreads());
+	std::vector<double> latency(LATENCY_SAMPLES);
+	for (int i = 0; i < LATENCY_SAMPLES; i++)
+	{
+		auto submitTime = BenchClock::now();
+		double* slot = &latency[i];
+		auto h = pool.submit([slot, submitTime]() { *slot = elapsedUs(submitTime, BenchClock::now()); });
+		Adapter::wait(h);
+	}
+
+	report.row("latency", 1, "p50", benchPercentile(latency, 0.5), "us");
+	report.row("latency", 1, "p99", benchPercentile(latency, 0.99), "us");
+	report.row("latency", 1, "p999", benchPercentile(latency, 0.999), "us");
+	report.row("latency", 1, "max", benchPercentile(latency, 1.0), "us");
+}
+
+// 一次提交FANOUT_WIDTH个任务，再等待全部完成
+template<typename Adapter>
+void benchFanout(const BenchReport& report, PoolMode mode)
+{
+	Adapter pool(mode, benchThreads());
+	std::vector<double> rounds;
+	for (int r = 0; r < FANOUT_ROUNDS; r++)
+	{
+		std::vector<typename Adapter::Handle> handles;
+		handles.reserve(FANOUT_WIDTH);
+		auto begin = BenchClock::now();
+		for (int i = 0; i < FANOUT_WIDTH; i++)
+		{
+			handles.emplace_back(pool.submit([]() {}));
+		}
+		for (auto &h : handles)
+		{
+			Adapter::wait(h);
+		}
+		rounds.push_back(elapsedUs(begin, BenchClock::now()));
+	}
+
+	report.row("fanout", 1, "round_p50", benchPercentile(rounds, 0.5), "us");
+	report.row("fanout", 1, "per_task_p50", benchPercentile(rounds, 0.5) / FANOUT_WIDTH, "us");
+}
+
+// 多个生产者同时提交，总任务数量不变
+template<typename Adapter>
+void benchContention(const BenchReport& report, PoolMode mode)
+{
+	int maxProducers = std::max(4, benchThreads());
+	for (int producers = 1; producers <= maxProducers; producers *= 2)
+	{
+		Adapter pool(mode, benchThreads());
+		int perProducer = CONTENTION_TASKS / producers;
+		std::vector<std::vector<typename Adapter::Handle>> handles(producers);
+		std::vector<std::thread> threads;
+		std::atomic_bool go(false);
+		for (int p = 0; p < producers; p++)
+		{
+			threads.emplace_back([&, p]() {
+				handles[p].reserve(perProducer);
+				while (!go)
+					std::this_thread::yield();
+				for (int i = 0; i < perProducer; i++)
+				{
+					handles[p].emplace_back(pool.submit([]() {}));
+				}
+			});
+		}
+
+		auto begin = BenchClock::now();
+		go = true;
+		for (auto &t : threads)
+			t.join();
+		for (auto &hs : handles)
+		{
+			for (auto &h : hs)
+				Adapter::wait(h);
+		}
+		auto end = BenchClock::now();
+		report.row("contention", producers, "complete_rate", perProducer * producers / elapsedUs(begin, end) * 1e6, "tasks/s");
+	}
+}
+
+// cached模式：从1个线程开始，提交CACHED_MAX_THREADS个互相等待的任务，
+// 线程池必须把线程数量扩到上限才能让所有任务同时开始执行；之后测量析构回收所有线程的时间
+template<typename Adapter>
+void benchSpawn(const BenchReport& report)
+{
+	std::atomic_int started(0);
+	std::atomic_bool release(false);
+	double spawnUs = 0;
+	int threads = 0;
+	auto teardownBegin = BenchClock::now();
+	{
+		Adapter pool(PoolMode::MODE_CACHED, 1);
+		std::vector<typename Adapter::Handle> handles;
+		auto begin = BenchClock::now();
+		for (int i = 0; i < CACHED_MAX_THREADS; i++)
+		{
+			handles.emplace_back(pool.submit([&]() {
+				started++;
+				while (!release)
+					std::this_thread::yield();
+			}));
+		}
+		auto deadline = begin + SPAWN_TIMEOUT;
+		while (started < CACHED_MAX_THREADS && BenchClock::now() < deadline)
+			std::this_thread::yield();
+		spawnUs = elapsedUs(begin, BenchClock::now());
+		threads = pool.threadSize();
+		release = true;
+		for (auto &h : handles)
+			Adapter::wait(h);
+		teardownBegin = BenchClock::now();
+	}
+	auto teardownEnd = BenchClock::now();
+
+	report.row("spawn", 1, "threads", threads, "threads");
+	report.row("spawn", 1, "concurrent_tasks", started, "tasks");
+	report.row("spawn", 1, "spawn_per_thread", threads > 1 ? spawnUs / (threads - 1) : 0, "us");
+	report.row("spawn", 1, "teardown", elapsedUs(teardownBegin, teardownEnd), "us");
+}
+
+// 对一种线程池实现跑全部测试
+template<typename Adapter>
+void runAll(const char* impl)
+{
+	const std::pair<PoolMode, const char*> modes[] = {
+		{ PoolMode::MODE_FIXED, "fixed" },
+		{ PoolMode::MODE_CACHED, "cached" },
+	};
+	for (auto &mode : modes)
+	{
+		BenchReport report(impl, mode.second);
+		benchThroughput<Adapter>(report, mode.first);
+		benchLatency<Adapter>(report, mode.first);
+		benchFanout<Adapter>(report, mode.first);
+		benchContention<Adapter>(report, mode.first);
+		if (mode.first == PoolMode::MODE_CACHED)
+			benchSpawn<Adapter>(report);
+	}
+}
+
+#endif // !POOL_BENCH_H
@@ -0,0 +1,63 @@
+#include "../threadpool.h"
+#include "pool_bench.h"
+
+/*
+Task/Result线程池（threadpool.cpp）的基准测试，输出格式见pool_bench.h
+*/
+
+// 把可调用对象包装成Task
+template<typename Func>
+class FuncTask : public Task
+{
+public:
+	explicit FuncTask(Func func) : func_(std::move(func))
+	{}
+
+	Any run() override
+	{
+		func_();
+		return 0;
+	}
+
+private:
+	Func func_;
+};
+
+class ClassicAdapter
+{
+public:
+	using Handle = Result;
+
+	ClassicAdapter(PoolMode mode, int threads)
+	{
+		pool_.setMode(mode);
+		pool_.setThreadSizeThreshHold(CACHED_MAX_THREADS);
+		pool_.start(threads);
+	}
+
+	template<typename Func>
+	Handle submit(Func func)
+	{
+		return pool_.submitTask(std::make_shared<FuncTask<Func>>(std::move(func)));
+	}
+
+	static void wait(Handle& handle)
+	{
+		handle.get();
+	}
+
+	int threadSize() const
+	{
+		return pool_.getStats().threadSize_;
+	}
+
+private:
+	ThreadPool pool_;
+};
+
+int main()
+{
+	BenchReport::header();
+	runAll<ClassicAdapter>("classic");
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "../final/threadpool.h"
+#include "pool_bench.h"
+
+/*
+future线程池（final/threadpool.h）的基准测试，输出格式见pool_bench.h
+*/
+
+// 任务队列上限设大，测试不应该因为队列满而阻塞
+const int BENCH_QUE_MAX_SIZE = 1 << 22;
+
+class FinalAdapter
+{
+public:
+	using Handle = std::future<void>;
+
+	FinalAdapter(PoolMode mode, int threads)
+	{
+		pool_.setMode(mode);
+		pool_.setTaskQueMaxThreshHold(BENCH_QUE_MAX_SIZE);
+		pool_.setThreadSizeThreshHold(CACHED_MAX_THREADS);
+		pool_.start(threads);
+	}
+
+	template<typename Func>
+	Handle submit(Func func)
+	{
+		return pool_.submitTask(std::move(func));
+	}
+
+	static void wait(Handle& handle)
+	{
+		handle.get();
+	}
+
+	int threadSize() const
+	{
+		return pool_.getThreadSize();
+	}
+
+private:
+	ThreadPool pool_;
+};
+
+int main()
+{
+	BenchReport::header();
+	runAll<FinalAdapter>("final");
+	return 0;
+}
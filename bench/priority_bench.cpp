@@ -0,0 +1,76 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "../final/threadpool.h"
+
+/*
+高优先级任务在后台批量任务压满线程池时的排队延迟（提交到开始执行）
+对比普通先进先出队列和按优先级出队的队列
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const int BULK_COUNT = 4000;						// 后台批量任务数量
+const auto BULK_COST = std::chrono::microseconds(200);	// 每个后台任务的执行时间
+const int PROBE_COUNT = 100;						// 高优先级探测任务数量
+const auto PROBE_INTERVAL = std::chrono::milliseconds(5);
+
+// 忙等一段时间，模拟计算任务
+void spin(Clock::duration cost)
+{
+	auto end = Clock::now() + cost;
+	while (Clock::now() < end)
+	{
+	}
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+	return values[index];
+}
+
+void runCase(const char* name, TaskQueType type)
+{
+	ThreadPool pool;
+	pool.setTaskQueType(type);
+	pool.setTaskQueMaxThreshHold(BULK_COUNT + PROBE_COUNT);
+	pool.start(2);
+
+	std::vector<std::future<void>> bulk;
+	for (int i = 0; i < BULK_COUNT; i++)
+	{
+		bulk.emplace_back(pool.submitTask(TaskPriority::PRIORITY_LOW, spin, BULK_COST));
+	}
+
+	// 每个探测任务记录从提交到开始执行的时间
+	std::vector<double> latency(PROBE_COUNT);
+	std::vector<std::future<void>> probes;
+	for (int i = 0; i < PROBE_COUNT; i++)
+	{
+		auto submitTime = Clock::now();
+		probes.emplace_back(pool.submitTask(TaskPriority::PRIORITY_HIGH, [&latency, i, submitTime]() {
+			latency[i] = std::chrono::duration<double, std::micro>(Clock::now() - submitTime).count();
+		}));
+		std::this_thread::sleep_for(PROBE_INTERVAL);
+	}
+	for (auto &f : probes)
+		f.get();
+	for (auto &f : bulk)
+		f.get();
+
+	std::cout << name << " high priority latency us: p50 " << percentile(latency, 0.5)
+		<< ", p99 " << percentile(latency, 0.99)
+		<< ", max " << percentile(latency, 1.0) << std::endl;
+}
+
+int main()
+{
+	runCase("fifo    ", TaskQueType::QUEUE_LOCKED);
+	runCase("priority", TaskQueType::QUEUE_PRIORITY);
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include "../threadpool.h"
+
+/*
+结果汇聚（fan-in）延迟测试
+1. 已经完成的结果：对比原来的Semaphore和CompletionEvent取结果的开销
+2. 跨线程交接：另一个线程依次完成，主线程依次等待
+3. 线程池：提交10万个任务后依次get()全部结果
+*/
+
+const int RESULT_COUNT = 100000;
+
+using Clock = std::chrono::steady_clock;
+
+double nsPer(Clock::time_point begin, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::nano>(end - begin).count() / RESULT_COUNT;
+}
+
+// 已经完成的结果，只测量等待的开销
+template<typename Event>
+double completedWait(void (*finish)(Event&), void (*wait)(Event&))
+{
+	std::vector<std::unique_ptr<Event>> events;
+	for (int i = 0; i < RESULT_COUNT; i++)
+	{
+		events.emplace_back(std::make_unique<Event>());
+		finish(*events.back());
+	}
+	auto begin = Clock::now();
+	for (auto &e : events)
+	{
+		wait(*e);
+	}
+	return nsPer(begin, Clock::now());
+}
+
+// 另一个线程依次完成，主线程依次等待
+template<typename Event>
+double handoffWait(void (*finish)(Event&), void (*wait)(Event&))
+{
+	std::vector<std::unique_ptr<Event>> events;
+	for (int i = 0; i < RESULT_COUNT; i++)
+	{
+		events.emplace_back(std::make_unique<Event>());
+	}
+	auto begin = Clock::now();
+	std::thread producer([&]() {
+		for (auto &e : events)
+		{
+			finish(*e);
+		}
+	});
+	for (auto &e : events)
+	{
+		wait(*e);
+	}
+	auto end = Clock::now();
+	producer.join();
+	return nsPer(begin, end);
+}
+
+class IndexTask : public TypedTask<int>
+{
+public:
+	IndexTask(int index) : index_(index)
+	{}
+	int run()
+	{
+		return index_;
+	}
+private:
+	int index_;
+};
+
+int main()
+{
+	auto semPost = [](Semaphore& s) { s.post(); };
+	auto semWait = [](Semaphore& s) { s.wait(); };
+	auto eventSet = [](CompletionEvent& e) { e.set(); };
+	auto eventWait = [](CompletionEvent& e) { e.wait(); };
+
+	double semDone = completedWait<Semaphore>(semPost, semWait);
+	double eventDone = completedWait<CompletionEvent>(eventSet, eventWait);
+	double semHandoff = handoffWait<Semaphore>(semPost, semWait);
+	double eventHandoff = handoffWait<CompletionEvent>(eventSet, eventWait);
+
+	// 线程池提交后汇聚全部结果
+	double poolFanIn;
+	int readyCount = 0;
+	{
+		ThreadPool pool;
+		pool.start(4);
+		std::vector<TypedResult<int>> results;
+		results.reserve(RESULT_COUNT);
+		for (int i = 0; i < RESULT_COUNT; i++)
+		{
+			results.emplace_back(pool.submitTask(std::make_shared<IndexTask>(i)));
+		}
+		auto begin = Clock::now();
+		long long sum = 0;
+		for (auto &res : results)
+		{
+			readyCount += res.ready();
+			sum += res.get();
+		}
+		poolFanIn = nsPer(begin, Clock::now());
+		if (sum != (long long)RESULT_COUNT * (RESULT_COUNT - 1) / 2)
+		{
+			std::cerr << "wrong sum: " << sum << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "fan-in of " << RESULT_COUNT << " results, ns per result" << std::endl;
+	std::cout << "completed, Semaphore       : " << semDone << std::endl;
+	std::cout << "completed, CompletionEvent : " << eventDone << std::endl;
+	std::cout << "handoff,   Semaphore       : " << semHandoff << std::endl;
+	std::cout << "handoff,   CompletionEvent : " << eventHandoff << std::endl;
+	std::cout << "pool TypedResult get()     : " << poolFanIn
+		<< " (" << readyCount << " already ready)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "../final/threadpool.h"
+
+/*
+大量延迟任务的到期误差（到期时间到开始执行）和添加开销
+对比在任务里sleep_for等待（每个等待占住一个工作线程），和scheduleAfter放入时间轮。
+重试退避之类的延迟任务不是按到期时间的顺序提交的，两种方式都按打乱的顺序提交
+*/
+
+using Clock = std::chrono::steady_clock;
+
+const int THREAD_SIZE = 4;
+const int TIMER_COUNT = 100000;							// scheduleAfter同时等待的延迟任务数量
+const int SLEEP_COUNT = 400;							// sleep_for方式的延迟任务数量，太多会排队很久
+const auto MIN_DELAY = std::chrono::milliseconds(200);	// 添加完所有任务之后才开始到期
+const auto MAX_DELAY = std::chrono::milliseconds(1000);	// 延迟在[MIN_DELAY, MIN_DELAY + MAX_DELAY)中均匀分布
+
+// 按打乱的顺序提交，order[k]是第k个提交的任务的下标
+std::vector<int> shuffled(int count)
+{
+	std::vector<int> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(1));
+	return order;
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+	return values[index];
+}
+
+void report(const char* name, const std::vector<double>& lateness, double addNs)
+{
+	std::cout << name << " add " << addNs << " ns/timer, lateness ms: p50 " << percentile(lateness, 0.5)
+		<< ", p99 " << percentile(lateness, 0.99)
+		<< ", max " << percentile(lateness, 1.0) << std::endl;
+}
+
+// 每个任务先sleep_for到到期时间再执行
+void runSleep()
+{
+	ThreadPool pool;
+	pool.setTaskQueMaxThreshHold(SLEEP_COUNT);
+	pool.start(THREAD_SIZE);
+
+	std::vector<double> lateness(SLEEP_COUNT);
+	std::vector<std::future<void>> results;
+	auto start = Clock::now();
+	for (int i : shuffled(SLEEP_COUNT))
+	{
+		auto due = start + MIN_DELAY + MAX_DELAY * i / SLEEP_COUNT;
+		results.emplace_back(pool.submitTask([&lateness, i, due]() {
+			std::this_thread::sleep_until(due);
+			lateness[i] = std::chrono::duration<double, std::milli>(Clock::now() - due).count();
+		}));
+	}
+	auto added = Clock::now();
+	for (auto &f : results)
+		f.get();
+	report("sleep_for    ", lateness, std::chrono::duration<double, std::nano>(added - start).count() / SLEEP_COUNT);
+}
+
+// 延迟任务放入时间轮，到期后才进入任务队列
+void runWheel()
+{
+	ThreadPool pool;
+	pool.setTaskQueMaxThreshHold(TIMER_COUNT);
+	pool.start(THREAD_SIZE);
+
+	std::vector<double> lateness(TIMER_COUNT);
+	std::vector<std::future<void>> results;
+	results.reserve(TIMER_COUNT);
+	std::vector<int> order = shuffled(TIMER_COUNT);
+	auto start = Clock::now();
+	for (int i : order)
+	{
+		// 延迟从调用scheduleAfter时开始计算，添加本身的耗时不算到期误差
+		auto due = start + MIN_DELAY + MAX_DELAY * i / TIMER_COUNT;
+		results.emplace_back(pool.scheduleAfter(due - Clock::now(), [&lateness, i, due]() {
+			lateness[i] = std::chrono::duration<double, std::milli>(Clock::now() - due).count();
+		}));
+	}
+	auto added = Clock::now();
+	for (auto &f : results)
+		f.get();
+	report("scheduleAfter", lateness, std::chrono::duration<double, std::nano>(added - start).count() / TIMER_COUNT);
+
+	// 周期任务：10ms一次，执行1秒
+	CancellationSource source;
+	std::atomic_int ticks(0);
+	pool.scheduleEvery(std::chrono::milliseconds(10), source.token(), [&ticks]() { ticks++; });
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	source.cancel();
+	std::cout << "scheduleEvery 10ms for 1s: " << ticks << " runs" << std::endl;
+}
+
+int main()
+{
+	runSleep();
+	runWheel();
+	return 0;
+}
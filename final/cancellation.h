@@ -0,0 +1,155 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+/*
+任务的协作式取消
+一个CancellationSource对应一次请求，这次请求提交的所有任务都带上它的token，调用一次cancel就全部取消。
+token还可以带一个截止时间，过了截止时间还没开始执行的任务同样视为取消。
+工作线程取出任务时先检查token，已经取消的任务不执行，结果对象报告TaskCancelled；
+已经开始执行的任务不会被打断，任务函数可以通过CancellationToken::current()轮询，自己提前结束
+*/
+
+/// <summary>
+/// 任务被取消或者超过截止时间，没有执行
+/// </summary>
+class TaskCancelled : public std::runtime_error
+{
+public:
+	TaskCancelled()
+		: std::runtime_error("task cancelled")
+	{}
+};
+
+/// <summary>
+/// 取消状态的只读视图，可以随意复制，默认构造的token永远不会被取消
+/// </summary>
+class CancellationToken
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	CancellationToken()
+		: deadline_(Clock::time_point::max())
+	{}
+
+	// 是否已经取消，或者已经过了截止时间
+	bool isCancelled() const
+	{
+		if (state_ != nullptr && state_->load(std::memory_order_acquire))
+			return true;
+		return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+	}
+
+	// 已经取消时抛出TaskCancelled，在任务函数中调用，结果对象同样报告取消
+	void throwIfCancelled() const
+	{
+		if (isCancelled())
+			throw TaskCancelled();
+	}
+
+	// 同一个取消状态，再加上截止时间，取较早的一个
+	CancellationToken withDeadline(Clock::time_point deadline) const
+	{
+		CancellationToken token = *this;
+		if (deadline < token.deadline_)
+			token.deadline_ = deadline;
+		return token;
+	}
+
+	template<typename Rep, typename Period>
+	CancellationToken withTimeout(const std::chrono::duration<Rep, Period>& timeout) const
+	{
+		return withDeadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+	}
+
+	Clock::time_point deadline() const
+	{
+		return deadline_;
+	}
+
+	// 当前线程正在执行的任务的token，不在任务中时返回永远不会取消的token
+	static const CancellationToken& current()
+	{
+		static const CancellationToken never;
+		const CancellationToken* token = currentSlot();
+		return token != nullptr ? *token : never;
+	}
+
+	/// <summary>
+	/// 执行任务期间把token设为当前线程的token，结束时恢复，任务嵌套执行时也能正确恢复
+	/// </summary>
+	class Scope
+	{
+	public:
+		explicit Scope(const CancellationToken& token)
+			: prev_(currentSlot())
+		{
+			currentSlot() = &token;
+		}
+
+		~Scope()
+		{
+			currentSlot() = prev_;
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const CancellationToken* prev_;
+	};
+
+private:
+	friend class CancellationSource;
+
+	explicit CancellationToken(std::shared_ptr<std::atomic_bool> state)
+		: state_(std::move(state))
+		, deadline_(Clock::time_point::max())
+	{}
+
+	static const CancellationToken*& currentSlot()
+	{
+		thread_local const CancellationToken* token = nullptr;
+		return token;
+	}
+
+private:
+	std::shared_ptr<std::atomic_bool> state_;	// 为空时只看截止时间
+	Clock::time_point deadline_;
+};
+
+/// <summary>
+/// 取消的发起方，一次请求一个，cancel对从它得到的所有token生效
+/// </summary>
+class CancellationSource
+{
+public:
+	CancellationSource()
+		: state_(std::make_shared<std::atomic_bool>(false))
+	{}
+
+	void cancel()
+	{
+		state_->store(true, std::memory_order_release);
+	}
+
+	bool isCancelled() const
+	{
+		return state_->load(std::memory_order_acquire);
+	}
+
+	CancellationToken token() const
+	{
+		return CancellationToken(state_);
+	}
+
+private:
+	std::shared_ptr<std::atomic_bool> state_;
+};
+
+#endif // !CANCELLATION_H
@@ -0,0 +1,511 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "coroutine.h需要C++20协程支持，请使用-std=c++20编译"
+#endif
+
+#include <coroutine>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "threadpool.h"
+
+/*
+线程池上的协程
+CoTask<T>是惰性的协程，创建时不执行，被co_await时才开始；完成时直接恢复等待它的协程（对称转移），
+不经过future，等待的一方也不占用线程。协程中co_await pool.schedule()之后就在线程池的工作线程上运行，
+恢复协程的任务和submitTask提交的任务在同一个任务队列里，由同样的工作线程执行。
+when_all / when_any 同时启动一组CoTask，全部完成 / 第一个完成时恢复等待的协程。
+sync_wait在普通函数（比如main）中阻塞等待一个CoTask的结果，不要在工作线程中调用
+
+	CoTask<int> handle(ThreadPool& pool, int x)
+	{
+		co_await pool.schedule();
+		co_return x * 2;
+	}
+	int y = sync_wait(handle(pool, 21));
+*/
+
+template<typename T>
+class CoTask;
+
+/// <summary>
+/// 协程的返回值或者异常，void单独特化
+/// </summary>
+template<typename T>
+class CoResult
+{
+public:
+	template<typename U>
+	void return_value(U&& value)
+	{
+		value_.emplace(std::forward<U>(value));
+	}
+
+	void unhandled_exception() noexcept
+	{
+		error_ = std::current_exception();
+	}
+
+	// 取出结果，只能取一次；协程抛出了异常时在这里重新抛出
+	T result()
+	{
+		if (error_)
+			std::rethrow_exception(error_);
+		return std::move(*value_);
+	}
+
+private:
+	std::optional<T> value_;
+	std::exception_ptr error_;
+};
+
+template<>
+class CoResult<void>
+{
+public:
+	void return_void() noexcept
+	{}
+
+	void unhandled_exception() noexcept
+	{
+		error_ = std::current_exception();
+	}
+
+	void result()
+	{
+		if (error_)
+			std::rethrow_exception(error_);
+	}
+
+private:
+	std::exception_ptr error_;
+};
+
+/// <summary>
+/// CoTask的promise，协程结束时恢复等待它的协程
+/// </summary>
+template<typename T>
+class CoPromise : public CoResult<T>
+{
+public:
+	/// <summary>
+	/// 协程结束时转到等待它的协程继续执行，没有等待的协程时挂起，由CoTask析构时销毁
+	/// </summary>
+	class FinalAwaiter
+	{
+	public:
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<CoPromise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation_;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() noexcept
+		{}
+	};
+
+	CoTask<T> get_return_object() noexcept
+	{
+		return CoTask<T>(std::coroutine_handle<CoPromise>::from_promise(*this));
+	}
+
+	// 惰性执行，创建后先挂起，等到被co_await时再开始
+	std::suspend_always initial_suspend() noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() noexcept
+	{
+		return {};
+	}
+
+	void setContinuation(std::coroutine_handle<> continuation) noexcept
+	{
+		continuation_ = continuation;
+	}
+
+private:
+	std::coroutine_handle<> continuation_;	// 等待本协程结束的协程
+};
+
+/// <summary>
+/// 惰性的协程任务，只能移动，析构时销毁协程
+/// co_await一个CoTask会启动它并挂起当前协程，CoTask结束时在结束它的线程上恢复当前协程
+/// </summary>
+template<typename T = void>
+class CoTask
+{
+public:
+	using promise_type = CoPromise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	/// <summary>
+	/// 启动协程并等待它结束，结果为协程的返回值
+	/// </summary>
+	class Awaiter
+	{
+	public:
+		explicit Awaiter(Handle handle)
+			: handle_(handle)
+		{}
+
+		bool await_ready() const noexcept
+		{
+			return handle_.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle_.promise().setContinuation(awaiting);
+			return handle_;
+		}
+
+		T await_resume()
+		{
+			return handle_.promise().result();
+		}
+
+	protected:
+		Handle handle_;
+	};
+
+	/// <summary>
+	/// 只等待协程结束，不取结果，也不抛出协程的异常
+	/// </summary>
+	class ReadyAwaiter : public Awaiter
+	{
+	public:
+		using Awaiter::Awaiter;
+
+		void await_resume() noexcept
+		{}
+	};
+
+	CoTask() = default;
+
+	explicit CoTask(Handle handle)
+		: handle_(handle)
+	{}
+
+	CoTask(CoTask&& other) noexcept
+		: handle_(std::exchange(other.handle_, nullptr))
+	{}
+
+	CoTask& operator=(CoTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			destroy();
+			handle_ = std::exchange(other.handle_, nullptr);
+		}
+		return *this;
+	}
+
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+
+	~CoTask()
+	{
+		destroy();
+	}
+
+	bool valid() const
+	{
+		return handle_ != nullptr;
+	}
+
+	bool done() const
+	{
+		return handle_.done();
+	}
+
+	Awaiter operator co_await() const noexcept
+	{
+		return Awaiter(handle_);
+	}
+
+	ReadyAwaiter whenReady() const noexcept
+	{
+		return ReadyAwaiter(handle_);
+	}
+
+	// 已经结束的协程的结果，只能取一次
+	T result()
+	{
+		return handle_.promise().result();
+	}
+
+private:
+	void destroy()
+	{
+		if (handle_)
+		{
+			handle_.destroy();
+			handle_ = nullptr;
+		}
+	}
+
+private:
+	Handle handle_;
+};
+
+/// <summary>
+/// 启动后一直运行到结束、结束时自己销毁的协程，when_all / when_any / sync_wait内部用来等待子协程
+/// </summary>
+class CoDetached
+{
+public:
+	struct promise_type
+	{
+		CoDetached get_return_object() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void() noexcept
+		{}
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+	};
+};
+
+/// <summary>
+/// 启动一组CoTask，全部结束后恢复等待的协程
+/// 计数比任务数量多1，多出的1在await_suspend启动完所有任务之后扣掉：
+/// 任务在此之前就全部结束时不挂起，避免在await_suspend返回之前被其他线程恢复
+/// </summary>
+template<typename T>
+class CoWhenAllAwaiter
+{
+public:
+	explicit CoWhenAllAwaiter(std::vector<CoTask<T>>& tasks)
+		: tasks_(tasks)
+		, count_(tasks.size() + 1)
+	{}
+
+	bool await_ready() const noexcept
+	{
+		return tasks_.empty();
+	}
+
+	bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		continuation_ = awaiting;
+		for (auto &task : tasks_)
+		{
+			watch(task, *this);
+		}
+		return count_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+	}
+
+	void await_resume() noexcept
+	{}
+
+private:
+	static CoDetached watch(CoTask<T>& task, CoWhenAllAwaiter& self)
+	{
+		co_await task.whenReady();
+		// 最后一个结束的任务恢复等待的协程
+		if (self.count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			self.continuation_.resume();
+	}
+
+private:
+	std::vector<CoTask<T>>& tasks_;
+	std::atomic_size_t count_;
+	std::coroutine_handle<> continuation_;
+};
+
+/// <summary>
+/// when_any的共享状态，持有所有任务
+/// when_any返回后没有结束的任务还在运行，由它们的等待协程持有状态，全部结束后才销毁
+/// </summary>
+template<typename T>
+class CoWhenAnyState
+{
+public:
+	explicit CoWhenAnyState(std::vector<CoTask<T>> tasks)
+		: tasks_(std::move(tasks))
+		, count_(2)
+		, done_(false)
+		, index_(0)
+	{}
+
+	/// <summary>
+	/// 启动所有任务，第一个结束时恢复等待的协程
+	/// 计数为2，第一个结束的任务和await_suspend各扣一次，后扣的一方负责恢复
+	/// </summary>
+	class Awaiter
+	{
+	public:
+		explicit Awaiter(std::shared_ptr<CoWhenAnyState> state)
+			: state_(std::move(state))
+		{}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			state_->continuation_ = awaiting;
+			for (size_t i = 0; i < state_->tasks_.size(); i++)
+			{
+				watch(state_, i);
+			}
+			return state_->count_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+		// 第一个结束的任务的下标
+		size_t await_resume() const noexcept
+		{
+			return state_->index_;
+		}
+
+	private:
+		std::shared_ptr<CoWhenAnyState> state_;
+	};
+
+	CoTask<T>& task(size_t index)
+	{
+		return tasks_[index];
+	}
+
+private:
+	static CoDetached watch(std::shared_ptr<CoWhenAnyState> state, size_t index)
+	{
+		co_await state->tasks_[index].whenReady();
+		// 只有第一个结束的任务参与计数
+		if (!state->done_.exchange(true, std::memory_order_acq_rel))
+		{
+			state->index_ = index;
+			if (state->count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				state->continuation_.resume();
+		}
+	}
+
+private:
+	std::vector<CoTask<T>> tasks_;
+	std::atomic_size_t count_;
+	std::atomic_bool done_;
+	size_t index_;
+	std::coroutine_handle<> continuation_;
+};
+
+// 同时启动所有任务，全部结束后按顺序返回结果；有任务抛出异常时重新抛出下标最小的那个
+template<typename T>
+CoTask<std::vector<T>> when_all(std::vector<CoTask<T>> tasks)
+{
+	co_await CoWhenAllAwaiter<T>(tasks);
+	std::vector<T> results;
+	results.reserve(tasks.size());
+	for (auto &task : tasks)
+	{
+		results.push_back(task.result());
+	}
+	co_return results;
+}
+
+inline CoTask<void> when_all(std::vector<CoTask<void>> tasks)
+{
+	co_await CoWhenAllAwaiter<void>(tasks);
+	for (auto &task : tasks)
+	{
+		task.result();
+	}
+}
+
+// 同时启动所有任务，返回第一个结束的任务的下标和结果，它抛出的异常在这里重新抛出
+// 其他任务不会被取消，继续运行到结束，结果被丢弃
+template<typename T>
+CoTask<std::pair<size_t, T>> when_any(std::vector<CoTask<T>> tasks)
+{
+	if (tasks.empty())
+		throw std::invalid_argument("when_any: no tasks");
+	auto state = std::make_shared<CoWhenAnyState<T>>(std::move(tasks));
+	size_t index = co_await typename CoWhenAnyState<T>::Awaiter(state);
+	co_return std::make_pair(index, state->task(index).result());
+}
+
+inline CoTask<size_t> when_any(std::vector<CoTask<void>> tasks)
+{
+	if (tasks.empty())
+		throw std::invalid_argument("when_any: no tasks");
+	auto state = std::make_shared<CoWhenAnyState<void>>(std::move(tasks));
+	size_t index = co_await CoWhenAnyState<void>::Awaiter(state);
+	state->task(index).result();
+	co_return index;
+}
+
+/// <summary>
+/// sync_wait用的一次性事件，持有锁通知，set返回后等待方才能继续
+/// </summary>
+class CoSyncEvent
+{
+public:
+	void set()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		set_ = true;
+		cond_.notify_all();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		cond_.wait(lock, [&]() -> bool { return set_; });
+	}
+
+private:
+	std::mutex mtx_;
+	std::condition_variable cond_;
+	bool set_ = false;
+};
+
+template<typename T>
+CoDetached coSyncWatch(CoTask<T>& task, CoSyncEvent& event)
+{
+	co_await task.whenReady();
+	event.set();
+}
+
+// 在当前线程启动任务并阻塞等待结果，任务中的异常在这里重新抛出
+template<typename T>
+T sync_wait(CoTask<T> task)
+{
+	CoSyncEvent event;
+	coSyncWatch(task, event);
+	event.wait();
+	return task.result();
+}
+
+#endif // !COROUTINE_H
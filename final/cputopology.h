@@ -0,0 +1,287 @@
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#endif
+
+/// <summary>
+/// 工作线程绑定CPU的方式
+/// </summary>
+enum class AffinityPolicy
+{
+	AFFINITY_NONE,	// 不绑定，由操作系统调度
+	AFFINITY_CORE,	// 每个线程绑定一个物理核，各个NUMA节点轮流分配
+	AFFINITY_NODE,	// 每个线程绑定一个NUMA节点（通常就是一个CPU插槽）的所有CPU，各个节点轮流分配
+	AFFINITY_LIST,	// 按用户给出的CPU列表，每个线程绑定一个CPU
+};
+
+/// <summary>
+/// 一个逻辑CPU的位置
+/// </summary>
+struct CpuInfo
+{
+	int cpu_;		// 逻辑CPU编号
+	int core_;		// 物理核编号，同一个物理核上的超线程相同
+	int package_;	// CPU插槽编号
+	int node_;		// NUMA节点编号
+};
+
+/// <summary>
+/// CPU拓扑：当前进程可以使用的逻辑CPU，以及它们所在的物理核和NUMA节点
+/// Linux下从sysfs读取，其他平台或者读取失败时退化为一个NUMA节点，每个逻辑CPU单独算一个核
+/// </summary>
+class CpuTopology
+{
+public:
+	CpuTopology() = default;
+
+	// 使用给定的CPU列表，比如只使用部分NUMA节点
+	explicit CpuTopology(std::vector<CpuInfo> cpus)
+		: cpus_(std::move(cpus))
+	{
+		std::sort(cpus_.begin(), cpus_.end(),
+				  [](const CpuInfo& a, const CpuInfo& b) { return a.cpu_ < b.cpu_; });
+		for (auto &info : cpus_)
+		{
+			if (std::find(nodes_.begin(), nodes_.end(), info.node_) == nodes_.end())
+				nodes_.push_back(info.node_);
+		}
+		std::sort(nodes_.begin(), nodes_.end());
+	}
+
+	// 读取当前进程可以使用的CPU
+	static CpuTopology detect()
+	{
+		std::vector<CpuInfo> cpus;
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			std::vector<int> nodeOf = readNodes();
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (!CPU_ISSET(cpu, &set))
+					continue;
+				std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+				int core = readInt(dir + "core_id", cpu);
+				int package = readInt(dir + "physical_package_id", 0);
+				int node = cpu < (int)nodeOf.size() && nodeOf[cpu] >= 0 ? nodeOf[cpu] : 0;
+				cpus.push_back(CpuInfo{ cpu, core, package, node });
+			}
+		}
+#endif
+		if (cpus.empty())
+		{
+			int count = std::max(1u, std::thread::hardware_concurrency());
+			for (int cpu = 0; cpu < count; cpu++)
+			{
+				cpus.push_back(CpuInfo{ cpu, cpu, 0, 0 });
+			}
+		}
+		return CpuTopology(std::move(cpus));
+	}
+
+	const std::vector<CpuInfo>& cpus() const
+	{
+		return cpus_;
+	}
+
+	// NUMA节点数量
+	int nodeCount() const
+	{
+		return std::max(1, (int)nodes_.size());
+	}
+
+	// 逻辑CPU所在NUMA节点的下标，范围[0, nodeCount())，未知的CPU返回0
+	int nodeIndexOfCpu(int cpu) const
+	{
+		for (auto &info : cpus_)
+		{
+			if (info.cpu_ == cpu)
+				return nodeIndex(info.node_);
+		}
+		return 0;
+	}
+
+	// 第index个NUMA节点的所有逻辑CPU
+	std::vector<int> cpusOfNode(int index) const
+	{
+		std::vector<int> result;
+		for (auto &info : cpus_)
+		{
+			if (nodeIndex(info.node_) == index)
+				result.push_back(info.cpu_);
+		}
+		return result;
+	}
+
+	// 按逻辑CPU编号查NUMA节点下标的表，提交任务时用来快速查找
+	std::vector<int> nodeIndexTable() const
+	{
+		std::vector<int> table;
+		for (auto &info : cpus_)
+		{
+			if (info.cpu_ >= (int)table.size())
+				table.resize(info.cpu_ + 1, 0);
+			table[info.cpu_] = nodeIndex(info.node_);
+		}
+		return table;
+	}
+
+	// 每个物理核取一个逻辑CPU，各个NUMA节点轮流排列，线程数量少于核数时也能分散到所有节点
+	std::vector<int> onePerCore() const
+	{
+		std::vector<std::vector<int>> perNode(nodeCount());
+		std::vector<std::pair<int, int>> seen;	// (插槽, 物理核)
+		for (auto &info : cpus_)
+		{
+			auto key = std::make_pair(info.package_, info.core_);
+			if (std::find(seen.begin(), seen.end(), key) != seen.end())
+				continue;
+			seen.push_back(key);
+			perNode[nodeIndex(info.node_)].push_back(info.cpu_);
+		}
+		std::vector<int> result;
+		for (size_t i = 0; result.size() < seen.size(); i++)
+		{
+			for (auto &cpus : perNode)
+			{
+				if (i < cpus.size())
+					result.push_back(cpus[i]);
+			}
+		}
+		return result;
+	}
+
+	// 按绑定方式计算每个线程绑定的CPU集合，线程数量超过CPU数量时循环使用；不绑定的线程对应空集合
+	std::vector<std::vector<int>> placements(AffinityPolicy policy, const std::vector<int>& list, int threadSize) const
+	{
+		std::vector<std::vector<int>> result;
+		if (policy == AffinityPolicy::AFFINITY_NONE)
+			return result;
+		std::vector<int> cores = onePerCore();
+		int nodes = nodeCount();
+		for (int i = 0; i < threadSize; i++)
+		{
+			std::vector<int> cpus;
+			switch (policy)
+			{
+			case AffinityPolicy::AFFINITY_CORE:
+				if (!cores.empty())
+					cpus.push_back(cores[i % cores.size()]);
+				break;
+			case AffinityPolicy::AFFINITY_NODE:
+				cpus = cpusOfNode(i % nodes);
+				break;
+			case AffinityPolicy::AFFINITY_LIST:
+				if (!list.empty())
+					cpus.push_back(list[i % list.size()]);
+				break;
+			default:
+				break;
+			}
+			result.emplace_back(std::move(cpus));
+		}
+		return result;
+	}
+
+	// 当前线程正在运行的逻辑CPU，未知时返回-1
+	static int currentCpu()
+	{
+#ifdef __linux__
+		return sched_getcpu();
+#else
+		return -1;
+#endif
+	}
+
+	// 把当前线程绑定到给定的逻辑CPU集合上
+	static bool pinCurrentThread(const std::vector<int>& cpus)
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus)
+		{
+			if (cpu >= 0 && cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+		return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)cpus;
+		return false;
+#endif
+	}
+
+private:
+	int nodeIndex(int node) const
+	{
+		auto it = std::find(nodes_.begin(), nodes_.end(), node);
+		return it == nodes_.end() ? 0 : (int)(it - nodes_.begin());
+	}
+
+#ifdef __linux__
+	static int readInt(const std::string& path, int defaultValue)
+	{
+		std::ifstream ifs(path);
+		int value;
+		if (ifs >> value)
+			return value;
+		return defaultValue;
+	}
+
+	// 读取每个逻辑CPU所在的NUMA节点，下标为CPU编号，没有NUMA信息时返回空
+	static std::vector<int> readNodes()
+	{
+		std::vector<int> nodeOf;
+		DIR* dir = opendir("/sys/devices/system/node");
+		if (dir == nullptr)
+			return nodeOf;
+		while (dirent* entry = readdir(dir))
+		{
+			int node;
+			char tail;
+			if (sscanf(entry->d_name, "node%d%c", &node, &tail) != 1)
+				continue;
+			std::ifstream ifs("/sys/devices/system/node/" + std::string(entry->d_name) + "/cpulist");
+			std::string list;
+			std::getline(ifs, list);
+			// 格式如 0-3,8-11
+			std::stringstream ss(list);
+			std::string range;
+			while (std::getline(ss, range, ','))
+			{
+				int first = -1, last = -1;
+				if (sscanf(range.c_str(), "%d-%d", &first, &last) < 2)
+					last = first;
+				for (int cpu = first; cpu >= 0 && cpu <= last; cpu++)
+				{
+					if (cpu >= (int)nodeOf.size())
+						nodeOf.resize(cpu + 1, -1);
+					nodeOf[cpu] = node;
+				}
+			}
+		}
+		closedir(dir);
+		return nodeOf;
+	}
+#endif
+
+private:
+	std::vector<CpuInfo> cpus_;
+	std::vector<int> nodes_;	// 出现过的NUMA节点编号，从小到大
+};
+
+#endif // !CPUTOPOLOGY_H
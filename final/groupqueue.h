@@ -0,0 +1,164 @@
+#ifndef GROUPQUEUE_H
+#define GROUPQUEUE_H
+
+#include <queue>
+#include <deque>
+#include <string>
+#include <cstddef>
+
+/*
+多租户的分组任务队列
+一个线程池给多个租户或子系统使用时，每个租户一个分组，每个分组有自己的队列、自己的上限和权重。
+出队按加权的赤字轮转（Deficit Round Robin）：每轮给有任务的分组发放等于权重的额度，
+每出队一个任务消耗一个额度，额度用完轮到下一个分组。积压很多任务的分组只会占满自己的队列，
+按权重分到自己的那部分线程时间，不会推高其他分组的排队延迟
+*/
+
+// 分组的默认权重
+const int GROUP_DEFAULT_WEIGHT = 1;
+
+/// <summary>
+/// 按分组加权轮转出队的任务队列，需要外部加锁
+/// 分组只在开始使用前添加，下标从0开始，0号分组是默认分组
+/// </summary>
+template<typename T>
+class GroupTaskQueue
+{
+public:
+	GroupTaskQueue() : size_(0)
+	{}
+
+	// 添加分组，maxSize为分组队列的上限，由使用方检查，返回分组下标
+	int addGroup(std::string name, int weight, size_t maxSize)
+	{
+		Group group;
+		group.name_ = std::move(name);
+		group.weight_ = weight < 1 ? 1 : weight;
+		group.maxSize_ = maxSize;
+		groups_.emplace_back(std::move(group));
+		return (int)groups_.size() - 1;
+	}
+
+	// 放入任务，分组从空变为非空时排到轮转的末尾
+	void push(T item, int group)
+	{
+		Group& g = groups_[group];
+		g.que_.emplace(std::move(item));
+		if (!g.active_)
+		{
+			g.active_ = true;
+			g.deficit_ = 0;
+			active_.push_back(group);
+		}
+		size_++;
+	}
+
+	// 取出下一个要执行的任务，group返回任务所在的分组
+	bool pop(T& item, int& group)
+	{
+		if (active_.empty())
+			return false;
+		group = active_.front();
+		Group& g = groups_[group];
+		// 轮到这个分组时发放一轮的额度
+		if (g.deficit_ == 0)
+			g.deficit_ = g.weight_;
+		item = std::move(g.que_.front());
+		g.que_.pop();
+		g.deficit_--;
+		size_--;
+
+		if (g.que_.empty())
+		{
+			// 空的分组不保留剩余额度，下次有任务时重新排队
+			active_.pop_front();
+			g.active_ = false;
+			g.deficit_ = 0;
+		}
+		else if (g.deficit_ == 0)
+		{
+			// 额度用完，轮到下一个分组
+			active_.pop_front();
+			active_.push_back(group);
+		}
+		return true;
+	}
+
+	// 取出分组中最早的任务，分组队列满需要丢弃任务时使用
+	bool popFront(T& item, int group)
+	{
+		Group& g = groups_[group];
+		if (g.que_.empty())
+			return false;
+		item = std::move(g.que_.front());
+		g.que_.pop();
+		size_--;
+		if (g.que_.empty())
+		{
+			g.active_ = false;
+			g.deficit_ = 0;
+			for (auto it = active_.begin(); it != active_.end(); ++it)
+			{
+				if (*it == group)
+				{
+					active_.erase(it);
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	// 分组中排队的任务数量
+	size_t groupSize(int group) const
+	{
+		return groups_[group].que_.size();
+	}
+
+	int groupCount() const
+	{
+		return (int)groups_.size();
+	}
+
+	const std::string& name(int group) const
+	{
+		return groups_[group].name_;
+	}
+
+	int weight(int group) const
+	{
+		return groups_[group].weight_;
+	}
+
+	size_t maxSize(int group) const
+	{
+		return groups_[group].maxSize_;
+	}
+
+private:
+	struct Group
+	{
+		std::string name_;
+		int weight_ = GROUP_DEFAULT_WEIGHT;	// 每轮可以连续出队的任务数量
+		size_t maxSize_ = 0;	// 分组队列的上限，0表示使用方的默认上限
+		std::queue<T> que_;
+		int deficit_ = 0;		// 这一轮剩余的额度
+		bool active_ = false;	// 是否在轮转中
+	};
+
+	std::deque<Group> groups_;	// 添加分组时不移动已有的分组
+	std::deque<int> active_;	// 有任务的分组，队头是正在出队的分组
+	size_t size_;
+};
+
+#endif // !GROUPQUEUE_H
@@ -0,0 +1,240 @@
+#ifndef INPLACETASK_H
+#define INPLACETASK_H
+
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 任务对象内联存储的大小，加上操作表指针后一个任务对象正好占满一个缓存行
+const size_t TASK_INLINE_SIZE = 48;
+
+/// <summary>
+/// 只能移动的类型擦除任务对象，代替std::function<void()>
+/// 可调用对象不超过TASK_INLINE_SIZE时直接构造在对象内部，不分配堆内存，
+/// 超过时才退化为在堆上分配
+/// </summary>
+class InplaceTask
+{
+public:
+	InplaceTask() noexcept : ops_(nullptr)
+	{}
+
+	InplaceTask(std::nullptr_t) noexcept : ops_(nullptr)
+	{}
+
+	template<typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, InplaceTask>>>
+	InplaceTask(Func&& func)
+	{
+		using F = std::decay_t<Func>;
+		if constexpr (isInline<F>())
+		{
+			new (buf_) F(std::forward<Func>(func));
+			ops_ = &InlineOps<F>::ops;
+		}
+		else
+		{
+			*reinterpret_cast<F**>(buf_) = new F(std::forward<Func>(func));
+			ops_ = &HeapOps<F>::ops;
+		}
+	}
+
+	InplaceTask(InplaceTask&& other) noexcept : ops_(other.ops_)
+	{
+		if (ops_ != nullptr)
+		{
+			ops_->move(buf_, other.buf_);
+			other.ops_ = nullptr;
+		}
+	}
+
+	InplaceTask& operator=(InplaceTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.ops_ != nullptr)
+			{
+				other.ops_->move(buf_, other.buf_);
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	InplaceTask& operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	~InplaceTask()
+	{
+		reset();
+	}
+
+	InplaceTask(const InplaceTask&) = delete;
+	InplaceTask& operator=(const InplaceTask&) = delete;
+
+	// 执行任务
+	void operator()()
+	{
+		ops_->invoke(buf_);
+	}
+
+	// 不执行就丢弃任务，可调用对象有discard(std::exception_ptr)成员时先把原因交给它
+	void discard(std::exception_ptr reason) noexcept
+	{
+		if (ops_ != nullptr)
+		{
+			ops_->discard(buf_, std::move(reason));
+			reset();
+		}
+	}
+
+	// 可调用对象有cancelled()成员时由它决定任务是否已经取消，取消的任务应当丢弃而不是执行
+	bool cancelled() const
+	{
+		return ops_ != nullptr && ops_->cancelled(buf_);
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return ops_ != nullptr;
+	}
+
+	friend bool operator==(const InplaceTask& task, std::nullptr_t) noexcept
+	{
+		return task.ops_ == nullptr;
+	}
+
+	friend bool operator!=(const InplaceTask& task, std::nullptr_t) noexcept
+	{
+		return task.ops_ != nullptr;
+	}
+
+private:
+	// 类型擦除后的操作表，每种可调用对象类型一份
+	struct Ops
+	{
+		void (*invoke)(void* buf);
+		void (*move)(void* dst, void* src); // 把src的可调用对象移动到dst，并析构src中的对象
+		void (*destroy)(void* buf);
+		void (*discard)(void* buf, std::exception_ptr reason);
+		bool (*cancelled)(const void* buf);
+	};
+
+	template<typename F, typename = void>
+	struct HasDiscard : std::false_type
+	{};
+
+	template<typename F>
+	struct HasDiscard<F, std::void_t<decltype(std::declval<F&>().discard(std::declval<std::exception_ptr>()))>>
+		: std::true_type
+	{};
+
+	template<typename F>
+	static void discardFunc(F& f, std::exception_ptr reason)
+	{
+		if constexpr (HasDiscard<F>::value)
+			f.discard(std::move(reason));
+	}
+
+	template<typename F, typename = void>
+	struct HasCancelled : std::false_type
+	{};
+
+	template<typename F>
+	struct HasCancelled<F, std::void_t<decltype(std::declval<const F&>().cancelled())>>
+		: std::true_type
+	{};
+
+	template<typename F>
+	static bool cancelledFunc(const F& f)
+	{
+		if constexpr (HasCancelled<F>::value)
+			return f.cancelled();
+		else
+			return false;
+	}
+
+	// 可调用对象能否放在内联存储里
+	template<typename F>
+	static constexpr bool isInline()
+	{
+		return sizeof(F) <= TASK_INLINE_SIZE
+			&& alignof(F) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<F>;
+	}
+
+	template<typename F>
+	struct InlineOps
+	{
+		static void invoke(void* buf)
+		{
+			(*static_cast<F*>(buf))();
+		}
+		static void move(void* dst, void* src)
+		{
+			F* f = static_cast<F*>(src);
+			new (dst) F(std::move(*f));
+			f->~F();
+		}
+		static void destroy(void* buf)
+		{
+			static_cast<F*>(buf)->~F();
+		}
+		static void discard(void* buf, std::exception_ptr reason)
+		{
+			discardFunc(*static_cast<F*>(buf), std::move(reason));
+		}
+		static bool cancelled(const void* buf)
+		{
+			return cancelledFunc(*static_cast<const F*>(buf));
+		}
+		static constexpr Ops ops = { &invoke, &move, &destroy, &discard, &cancelled };
+	};
+
+	template<typename F>
+	struct HeapOps
+	{
+		static void invoke(void* buf)
+		{
+			(**static_cast<F**>(buf))();
+		}
+		static void move(void* dst, void* src)
+		{
+			*static_cast<F**>(dst) = *static_cast<F**>(src);
+		}
+		static void destroy(void* buf)
+		{
+			delete *static_cast<F**>(buf);
+		}
+		static void discard(void* buf, std::exception_ptr reason)
+		{
+			discardFunc(**static_cast<F**>(buf), std::move(reason));
+		}
+		static bool cancelled(const void* buf)
+		{
+			return cancelledFunc(**static_cast<F* const*>(buf));
+		}
+		static constexpr Ops ops = { &invoke, &move, &destroy, &discard, &cancelled };
+	};
+
+	void reset() noexcept
+	{
+		if (ops_ != nullptr)
+		{
+			ops_->destroy(buf_);
+			ops_ = nullptr;
+		}
+	}
+
+private:
+	alignas(std::max_align_t) unsigned char buf_[TASK_INLINE_SIZE];
+	const Ops* ops_;
+};
+
+#endif // !INPLACETASK_H
@@ -0,0 +1,293 @@
+#ifndef IOPOLLER_H
+#define IOPOLLER_H
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+/*
+线程池等待文件描述符就绪的任务，两种线程池共用
+每个文件描述符可以同时等待可读和可写，各有一个回调任务，就绪后回调任务交给线程池，和普通任务一样排队执行。
+注册使用EPOLLONESHOT，一次就绪只交出一次回调，多个线程同时epoll_wait也不会重复交出；
+交出之后文件描述符留在epoll中但不再触发，下一次注册只需要EPOLL_CTL_MOD。
+阻塞在epoll_wait中的线程通过eventfd唤醒。只在第一次注册时创建epoll和eventfd，不使用的线程池不占用文件描述符
+*/
+
+// 一次epoll_wait最多取出的事件数量
+const int IO_POLL_BATCH = 64;
+
+// 等待的I/O事件
+enum class IoEvent
+{
+	IO_READABLE,	// 可读，对端关闭或者出错也算就绪
+	IO_WRITABLE,	// 可写，对端关闭或者出错也算就绪
+};
+
+/// <summary>
+/// 文件描述符就绪的回调，内部加锁，epoll_wait不持有锁
+/// </summary>
+template<typename T>
+class IoPoller
+{
+public:
+	IoPoller()
+		: epollFd_(-1), wakeFd_(-1), size_(0)
+	{}
+
+	~IoPoller()
+	{
+#ifdef __linux__
+		int epollFd = epollFd_.load(std::memory_order_relaxed);
+		int wakeFd = wakeFd_.load(std::memory_order_relaxed);
+		if (epollFd >= 0)
+			::close(epollFd);
+		if (wakeFd >= 0)
+			::close(wakeFd);
+#endif
+	}
+
+	IoPoller(const IoPoller&) = delete;
+	IoPoller& operator=(const IoPoller&) = delete;
+
+	// 等待fd上的event，就绪后在wait中交出item
+	// 同一个fd上已经在等待这个事件、fd不支持epoll（例如普通文件）或者不是Linux时返回false并设置errno，item保持不变
+	bool watch(int fd, IoEvent event, T& item)
+	{
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (!init())
+			return false;
+		Watch& watch = watches_[fd];
+		bool read = event == IoEvent::IO_READABLE;
+		if (read ? watch.hasRead_ : watch.hasWrite_)
+		{
+			errno = EEXIST;
+			return false;
+		}
+		uint32_t events = mask(watch.hasRead_ || read, watch.hasWrite_ || !read);
+		if (!arm(fd, watch, events))
+		{
+			int error = errno;
+			if (!watch.hasRead_ && !watch.hasWrite_ && !watch.registered_)
+				watches_.erase(fd);
+			errno = error;
+			return false;
+		}
+		if (read)
+		{
+			watch.read_ = std::move(item);
+			watch.hasRead_ = true;
+		}
+		else
+		{
+			watch.write_ = std::move(item);
+			watch.hasWrite_ = true;
+		}
+		size_.fetch_add(1);
+		return true;
+#else
+		errno = ENOSYS;
+		return false;
+#endif
+	}
+
+	// 等待最多timeoutMs毫秒（-1一直等待，0只检查），就绪的回调移到ready的末尾
+	// 只有阻塞等待的一方清除eventfd的唤醒，timeoutMs为0的检查不会吞掉发给阻塞线程的唤醒
+	void wait(int timeoutMs, std::vector<T>& ready)
+	{
+#ifdef __linux__
+		// 不加锁读取，init先发布wakeFd_再发布epollFd_
+		int epollFd = epollFd_.load(std::memory_order_acquire);
+		if (epollFd < 0)
+			return;
+		int wakeFd = wakeFd_.load(std::memory_order_relaxed);
+		epoll_event events[IO_POLL_BATCH];
+		int count = ::epoll_wait(epollFd, events, IO_POLL_BATCH, timeoutMs);
+		if (count <= 0)
+			return;
+		std::lock_guard<std::mutex> lock(mtx_);
+		for (int i = 0; i < count; i++)
+		{
+			int fd = events[i].data.fd;
+			if (fd == wakeFd)
+			{
+				if (timeoutMs != 0)
+				{
+					uint64_t value;
+					while (::read(wakeFd, &value, sizeof(value)) < 0 && errno == EINTR)
+						;
+				}
+				continue;
+			}
+			auto it = watches_.find(fd);
+			if (it == watches_.end())
+				continue;
+			Watch& watch = it->second;
+			uint32_t happened = events[i].events;
+			if (watch.hasRead_ && (happened & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+			{
+				ready.emplace_back(std::move(watch.read_));
+				watch.read_ = T();
+				watch.hasRead_ = false;
+				size_.fetch_sub(1, std::memory_order_relaxed);
+			}
+			if (watch.hasWrite_ && (happened & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+			{
+				ready.emplace_back(std::move(watch.write_));
+				watch.write_ = T();
+				watch.hasWrite_ = false;
+				size_.fetch_sub(1, std::memory_order_relaxed);
+			}
+			// 另一个方向还在等待，重新打开ONESHOT
+			if (watch.hasRead_ || watch.hasWrite_)
+				arm(fd, watch, mask(watch.hasRead_, watch.hasWrite_));
+		}
+#endif
+	}
+
+	// 唤醒阻塞在wait中的线程
+	void wake()
+	{
+#ifdef __linux__
+		int wakeFd = wakeFd_.load(std::memory_order_acquire);
+		if (wakeFd < 0)
+			return;
+		uint64_t value = 1;
+		while (::write(wakeFd, &value, sizeof(value)) < 0 && errno == EINTR)
+			;
+#endif
+	}
+
+	// 取出fd上还在等待的回调并从epoll中移除fd，关闭fd之前调用
+	void cancel(int fd, std::vector<T>& items)
+	{
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto it = watches_.find(fd);
+		if (it == watches_.end())
+			return;
+		take(it->second, items);
+		if (it->second.registered_)
+			::epoll_ctl(epollFd_.load(std::memory_order_relaxed), EPOLL_CTL_DEL, fd, nullptr);
+		watches_.erase(it);
+#endif
+	}
+
+	// 取出所有还在等待的回调
+	void clear(std::vector<T>& items)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		for (auto &entry : watches_)
+		{
+			take(entry.second, items);
+		}
+	}
+
+	// 还在等待的回调数量
+	size_t size() const
+	{
+		return size_.load();
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+private:
+	struct Watch
+	{
+		T read_;
+		T write_;
+		bool hasRead_ = false;
+		bool hasWrite_ = false;
+		bool registered_ = false;	// fd已经加入epoll，之后用EPOLL_CTL_MOD
+	};
+
+	void take(Watch& watch, std::vector<T>& items)
+	{
+		if (watch.hasRead_)
+			items.emplace_back(std::move(watch.read_));
+		if (watch.hasWrite_)
+			items.emplace_back(std::move(watch.write_));
+		size_.fetch_sub((size_t)watch.hasRead_ + (size_t)watch.hasWrite_, std::memory_order_relaxed);
+		watch.read_ = T();
+		watch.write_ = T();
+		watch.hasRead_ = false;
+		watch.hasWrite_ = false;
+	}
+
+#ifdef __linux__
+	static uint32_t mask(bool read, bool write)
+	{
+		return (read ? uint32_t(EPOLLIN | EPOLLRDHUP) : 0u) | (write ? uint32_t(EPOLLOUT) : 0u) | EPOLLONESHOT;
+	}
+
+	// 第一次注册时创建epoll和用来唤醒的eventfd，调用方持有mtx_
+	bool init()
+	{
+		if (epollFd_.load(std::memory_order_relaxed) >= 0)
+			return true;
+		int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+		if (epollFd < 0)
+			return false;
+		int wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = wakeFd;
+		if (wakeFd < 0 || ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0)
+		{
+			int error = errno;
+			if (wakeFd >= 0)
+				::close(wakeFd);
+			::close(epollFd);
+			errno = error;
+			return false;
+		}
+		wakeFd_.store(wakeFd, std::memory_order_release);
+		epollFd_.store(epollFd, std::memory_order_release);
+		return true;
+	}
+
+	// 按events重新打开fd的ONESHOT；fd关闭后号码被复用时epoll中已经没有它，改为重新加入
+	bool arm(int fd, Watch& watch, uint32_t events)
+	{
+		int epollFd = epollFd_.load(std::memory_order_relaxed);
+		epoll_event event{};
+		event.events = events;
+		event.data.fd = fd;
+		if (watch.registered_)
+		{
+			if (::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0)
+				return true;
+			if (errno != ENOENT)
+				return false;
+			watch.registered_ = false;
+		}
+		if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+			return false;
+		watch.registered_ = true;
+		return true;
+	}
+#endif
+
+	std::mutex mtx_;	// 保护watches_，以及epollFd_和wakeFd_的创建
+	std::atomic_int epollFd_;	// wait和wake不加锁读取
+	std::atomic_int wakeFd_;	// 唤醒阻塞在epoll_wait中的线程
+	std::unordered_map<int, Watch> watches_;	// 注册过的fd，交出回调之后保留，下一次注册直接MOD
+	std::atomic<size_t> size_;	// 还在等待的回调数量，为0时线程池不进入epoll_wait
+};
+
+#endif // !IOPOLLER_H
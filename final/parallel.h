@@ -0,0 +1,233 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "threadpool.h"
+
+// 自动粒度时，区间大约拆成 (线程数量 + 1) * PARALLEL_CHUNKS_PER_THREAD 块
+const int PARALLEL_CHUNKS_PER_THREAD = 8;
+
+/// <summary>
+/// parallel_for / parallel_reduce 的实现
+/// 调用线程自己处理区间的前半部分，线程池有空闲线程时把剩余区间的后一半拆给线程池，
+/// 没有空闲线程时就按粒度一块一块自己处理，每处理完一块再看是否需要拆分。
+/// 最后把还没被线程池线程拿走的区间收回自己执行，只等待已经开始执行的区间，
+/// 所以在线程池线程里嵌套调用也不会把线程全部阻塞住
+/// </summary>
+template<typename Index, typename T, typename Map, typename Combine>
+class ParallelReducer
+{
+public:
+	ParallelReducer(ThreadPool& pool, Index grain, Map& map, Combine& combine)
+		: pool_(pool)
+		, grain_(grain)
+		, map_(map)
+		, combine_(combine)
+		, failed_(false)
+	{}
+
+	ParallelReducer(const ParallelReducer&) = delete;
+	ParallelReducer& operator=(const ParallelReducer&) = delete;
+
+	// 归约区间[begin, end)，区间为空时返回空
+	std::optional<T> run(Index begin, Index end)
+	{
+		std::vector<std::shared_ptr<Chunk>> spawned;
+		std::optional<T> result;
+		while (end - begin > grain_ && !failed_)
+		{
+			Index mid = begin + (end - begin) / 2;
+			if (pool_.getIdleThreadSize() > 0 && spawn(mid, end, spawned))
+			{
+				// 有空闲线程，后一半已经拆出去
+				end = mid;
+			}
+			else
+			{
+				// 没有空闲线程或者任务队列满，先自己处理一块
+				merge(result, runLeaf(begin, begin + grain_));
+				begin += grain_;
+			}
+		}
+		merge(result, runLeaf(begin, end));
+
+		// 拆出去的区间从左到右合并，还没被拿走的收回自己执行
+		for (auto it = spawned.rbegin(); it != spawned.rend(); ++it)
+		{
+			Chunk& chunk = **it;
+			if (!chunk.taken_.exchange(true))
+			{
+				chunk.result_ = run(chunk.begin_, chunk.end_);
+			}
+			else
+			{
+				std::unique_lock<std::mutex> lock(chunk.mtx_);
+				chunk.cond_.wait(lock, [&]() -> bool { return chunk.done_; });
+			}
+			merge(result, std::move(chunk.result_));
+		}
+		return result;
+	}
+
+	// 执行过程中有异常时，在调用线程重新抛出第一个异常
+	void rethrow()
+	{
+		if (error_)
+			std::rethrow_exception(error_);
+	}
+
+private:
+	// 拆给线程池的一段区间，由调用线程和线程池中的任务共同持有
+	struct Chunk
+	{
+		Chunk(ParallelReducer* owner, Index begin, Index end)
+			: owner_(owner), begin_(begin), end_(end), taken_(false), done_(false)
+		{}
+		ParallelReducer* owner_;	// 只在抢到taken_之后访问，调用线程等到done_才会返回
+		Index begin_;
+		Index end_;
+		std::atomic_bool taken_;	// 是否已经有线程开始执行
+		std::mutex mtx_;
+		std::condition_variable cond_;	// 执行完成
+		bool done_;					// 是否执行完成，由mtx_保护
+		std::optional<T> result_;
+	};
+
+	// 把[begin, end)拆给线程池，队列满时不等待也不使用拒绝策略，返回false由调用线程自己处理
+	bool spawn(Index begin, Index end, std::vector<std::shared_ptr<Chunk>>& spawned)
+	{
+		auto chunk = std::make_shared<Chunk>(this, begin, end);
+		ThreadPool::Task task = [chunk]() { runChunk(*chunk); };
+		if (!pool_.enqueueTask(task, TaskPriority::PRIORITY_NORMAL, ThreadPool::TimePoint::max(),
+							   ThreadPool::TimePoint::min()))
+			return false;
+		spawned.emplace_back(std::move(chunk));
+		return true;
+	}
+
+	// 线程池线程执行拆出去的区间，区间已经被调用线程收回时什么都不做，调用线程这时可能已经返回
+	static void runChunk(Chunk& chunk)
+	{
+		if (chunk.taken_.exchange(true))
+			return;
+		chunk.result_ = chunk.owner_->run(chunk.begin_, chunk.end_);
+		std::unique_lock<std::mutex> lock(chunk.mtx_);
+		chunk.done_ = true;
+		chunk.cond_.notify_all();
+	}
+
+	// 顺序处理一小段区间
+	std::optional<T> runLeaf(Index begin, Index end)
+	{
+		if (begin == end || failed_)
+			return std::nullopt;
+		try
+		{
+			T acc = map_(begin);
+			for (Index i = begin + 1; i != end; ++i)
+			{
+				acc = combine_(std::move(acc), map_(i));
+			}
+			return acc;
+		}
+		catch (...)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			if (!error_)
+				error_ = std::current_exception();
+			failed_ = true;
+			return std::nullopt;
+		}
+	}
+
+	void merge(std::optional<T>& acc, std::optional<T> value)
+	{
+		if (!value || failed_)
+			return;
+		if (!acc)
+		{
+			acc = std::move(value);
+			return;
+		}
+		try
+		{
+			acc = combine_(std::move(*acc), std::move(*value));
+		}
+		catch (...)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			if (!error_)
+				error_ = std::current_exception();
+			failed_ = true;
+		}
+	}
+
+private:
+	ThreadPool& pool_;
+	Index grain_;		// 每块最少处理的元素数量
+	Map& map_;
+	Combine& combine_;
+
+	std::mutex mtx_;				// 保护error_
+	std::exception_ptr error_;		// 第一个异常
+	std::atomic_bool failed_;		// 出现异常后停止处理剩余区间
+};
+
+// 计算自动粒度
+template<typename Index>
+Index parallelGrain(ThreadPool& pool, Index first, Index last, Index grain)
+{
+	if (grain > 0)
+		return grain;
+	Index chunks = (Index)((pool.getThreadSize() + 1) * PARALLEL_CHUNKS_PER_THREAD);
+	return std::max<Index>((last - first) / chunks, 1);
+}
+
+// 对[first, last)中的每个下标i并行执行fn(i)，调用线程也参与执行，全部执行完才返回
+// grain为每块最少处理的元素数量，传0表示按线程数量自动选择
+template<typename Index, typename Func>
+void parallel_for(ThreadPool& pool, Index first, std::common_type_t<Index> last,
+				  std::common_type_t<Index> grain, Func&& fn)
+{
+	if (!(first < last))
+		return;
+	struct Empty {};
+	auto map = [&](Index i) -> Empty { fn(i); return Empty(); };
+	auto combine = [](Empty, Empty) -> Empty { return Empty(); };
+	ParallelReducer<Index, Empty, decltype(map), decltype(combine)> reducer(
+		pool, parallelGrain(pool, first, last, grain), map, combine);
+	reducer.run(first, last);
+	reducer.rethrow();
+}
+
+template<typename Index, typename Func>
+void parallel_for(ThreadPool& pool, Index first, std::common_type_t<Index> last, Func&& fn)
+{
+	parallel_for(pool, first, last, Index(0), std::forward<Func>(fn));
+}
+
+// 并行计算 combine(init, map(first), map(first + 1), ..., map(last - 1))
+// 合并按照下标顺序进行，combine只需要满足结合律
+template<typename Index, typename T, typename Map, typename Combine>
+T parallel_reduce(ThreadPool& pool, Index first, std::common_type_t<Index> last,
+				  T init, Map&& map, Combine&& combine, std::common_type_t<Index> grain = 0)
+{
+	if (!(first < last))
+		return init;
+	ParallelReducer<Index, T, std::remove_reference_t<Map>, std::remove_reference_t<Combine>> reducer(
+		pool, parallelGrain(pool, first, last, grain), map, combine);
+	std::optional<T> result = reducer.run(first, last);
+	reducer.rethrow();
+	return combine(std::move(init), std::move(*result));
+}
+
+#endif // !PARALLEL_H
@@ -0,0 +1,448 @@
+#ifndef POOLSTATS_H
+#define POOLSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+/*
+线程池运行统计
+计数器尽量只由一个线程写：每个工作线程一份计数器和直方图，提交任务的计数按线程分散到多个缓存行，
+读取统计时才把它们汇总起来，所以统计本身不会给提交和执行任务增加锁竞争
+*/
+
+// 直方图每个2的幂区间再等分的份数，相对误差不超过 1 / HISTOGRAM_SUB_BUCKETS
+const int HISTOGRAM_SUB_BITS = 3;
+const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+const int HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+// 提交任务计数分散的缓存行数量
+const int STATS_COUNTER_STRIPES = 16;
+
+/// <summary>
+/// 延迟直方图的快照，单位纳秒
+/// 按HDR直方图的方式分桶：小于HISTOGRAM_SUB_BUCKETS的值每个值一个桶，
+/// 更大的值每个2的幂区间分成HISTOGRAM_SUB_BUCKETS个桶，覆盖整个uint64_t范围
+/// </summary>
+class HistogramSnapshot
+{
+public:
+	HistogramSnapshot()
+		: counts_(HISTOGRAM_BUCKETS, 0), count_(0), sum_(0), max_(0)
+	{}
+
+	// 记录的数值个数
+	uint64_t count() const
+	{
+		return count_;
+	}
+
+	double mean() const
+	{
+		return count_ == 0 ? 0.0 : (double)sum_ / count_;
+	}
+
+	uint64_t max() const
+	{
+		return max_;
+	}
+
+	// 百分位数，p取值[0, 100]，返回所在桶的上界，不超过记录过的最大值
+	uint64_t percentile(double p) const
+	{
+		if (count_ == 0)
+			return 0;
+		uint64_t rank = (uint64_t)(std::min(std::max(p, 0.0), 100.0) / 100.0 * count_);
+		rank = std::max<uint64_t>(rank, 1);
+		uint64_t seen = 0;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			seen += counts_[i];
+			if (seen >= rank)
+				return std::min(bucketUpper(i), max_);
+		}
+		return max_;
+	}
+
+	// 合并另一个快照
+	void merge(const HistogramSnapshot& other)
+	{
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			counts_[i] += other.counts_[i];
+		}
+		count_ += other.count_;
+		sum_ += other.sum_;
+		max_ = std::max(max_, other.max_);
+	}
+
+	// 数值所在的桶
+	static int bucketOf(uint64_t value)
+	{
+		if (value < (uint64_t)HISTOGRAM_SUB_BUCKETS)
+			return (int)value;
+		int exp = 63 - __builtin_clzll(value);
+		int sub = (int)(value >> (exp - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+		return (exp - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+	}
+
+	// 桶内的最大值
+	static uint64_t bucketUpper(int bucket)
+	{
+		if (bucket < HISTOGRAM_SUB_BUCKETS)
+			return bucket;
+		int exp = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+		uint64_t sub = bucket % HISTOGRAM_SUB_BUCKETS;
+		uint64_t width = 1ull << (exp - HISTOGRAM_SUB_BITS);
+		return ((HISTOGRAM_SUB_BUCKETS + sub) << (exp - HISTOGRAM_SUB_BITS)) + width - 1;
+	}
+
+private:
+	friend class LatencyHistogram;
+
+	std::vector<uint64_t> counts_;
+	uint64_t count_;
+	uint64_t sum_;
+	uint64_t max_;
+};
+
+/// <summary>
+/// 延迟直方图，只允许一个线程写，任意线程可以同时读取快照
+/// </summary>
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() : count_(0), sum_(0), max_(0)
+	{
+		for (auto &c : counts_)
+		{
+			c.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void record(uint64_t value)
+	{
+		bump(counts_[HistogramSnapshot::bucketOf(value)], 1);
+		bump(count_, 1);
+		bump(sum_, value);
+		if (value > max_.load(std::memory_order_relaxed))
+			max_.store(value, std::memory_order_relaxed);
+	}
+
+	// 把当前数据累加到快照中
+	void collect(HistogramSnapshot& snapshot) const
+	{
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			snapshot.counts_[i] += counts_[i].load(std::memory_order_relaxed);
+		}
+		snapshot.count_ += count_.load(std::memory_order_relaxed);
+		snapshot.sum_ += sum_.load(std::memory_order_relaxed);
+		snapshot.max_ = std::max(snapshot.max_, max_.load(std::memory_order_relaxed));
+	}
+
+private:
+	// 只有一个写线程，不需要原子的读改写
+	static void bump(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t> counts_[HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> max_;
+};
+
+/// <summary>
+/// 单个工作线程的统计快照
+/// </summary>
+struct WorkerStats
+{
+	int threadId_;			// 线程id
+	uint64_t completed_;	// 执行完成的任务数量
+	uint64_t busyNs_;		// 执行任务的总时间
+	uint64_t idleNs_;		// 两个任务之间空闲的总时间
+};
+
+/// <summary>
+/// 任务分组的统计快照，只有QUEUE_GROUPED任务队列有分组
+/// </summary>
+struct GroupStats
+{
+	std::string name_;				// 分组名称
+	int weight_ = 0;				// 分组权重
+	uint64_t submitted_ = 0;		// 成功放入分组队列的任务数量
+	uint64_t rejected_ = 0;			// 分组队列满没能放入的任务数量，包括被挤出队列的任务
+	uint64_t dequeued_ = 0;			// 从分组队列取出的任务数量
+	uint64_t queueDepth_ = 0;		// 当前排队的任务数量
+	HistogramSnapshot queueWait_;	// 分组中的任务从放入队列到被取出的时间
+};
+
+/// <summary>
+/// 线程池统计快照
+/// </summary>
+struct PoolStats
+{
+	uint64_t submitted_ = 0;		// 成功放入队列的任务数量
+	uint64_t completed_ = 0;		// 执行完成的任务数量
+	uint64_t rejected_ = 0;			// 队列满没能放入队列的任务数量，包括由提交线程执行和被挤出队列的任务
+	uint64_t cancelled_ = 0;		// 取出时已经取消或者超过截止时间、没有执行的任务数量
+	uint64_t queueDepth_ = 0;		// 当前排队的任务数量
+	uint64_t queueHighWater_ = 0;	// 排队任务数量的最大值
+	int threadSize_ = 0;			// 当前线程数量
+	int idleThreadSize_ = 0;		// 当前空闲线程数量
+	uint64_t busyNs_ = 0;			// 所有线程（包括已经回收的线程）执行任务的总时间
+	uint64_t idleNs_ = 0;			// 所有线程两个任务之间空闲的总时间
+	std::vector<WorkerStats> workers_;	// 当前存活的每个工作线程
+	std::vector<GroupStats> groups_;	// QUEUE_GROUPED任务队列的每个分组
+	HistogramSnapshot queueWait_;	// 任务从放入队列到开始执行的时间
+	HistogramSnapshot runTime_;		// 任务执行时间
+};
+
+/// <summary>
+/// 一个任务分组的计数器，出队的记录由持有任务队列锁的线程写，拒绝可以由任意线程写
+/// </summary>
+class alignas(64) GroupCounters
+{
+public:
+	GroupCounters()
+		: submitted_(0), rejected_(0), dequeued_(0), depth_(0)
+	{}
+
+	// 一个任务放入分组队列
+	void taskSubmitted()
+	{
+		submitted_.fetch_add(1, std::memory_order_relaxed);
+		depth_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 一个任务没能放入分组队列
+	void taskRejected()
+	{
+		rejected_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 一个排队的任务被新任务挤出分组队列
+	void taskEvicted()
+	{
+		rejected_.fetch_add(1, std::memory_order_relaxed);
+		depth_.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// 一个任务从分组队列取出，调用方需要持有任务队列的锁，保证直方图只有一个写线程
+	void taskDequeued(uint64_t queueWaitNs)
+	{
+		dequeued_.fetch_add(1, std::memory_order_relaxed);
+		depth_.fetch_sub(1, std::memory_order_relaxed);
+		queueWait_.record(queueWaitNs);
+	}
+
+	// 汇总到快照中
+	void collect(GroupStats& stats) const
+	{
+		stats.submitted_ = submitted_.load(std::memory_order_relaxed);
+		stats.rejected_ = rejected_.load(std::memory_order_relaxed);
+		stats.dequeued_ = dequeued_.load(std::memory_order_relaxed);
+		stats.queueDepth_ = depth_.load(std::memory_order_relaxed);
+		queueWait_.collect(stats.queueWait_);
+	}
+
+private:
+	std::atomic<uint64_t> submitted_;
+	std::atomic<uint64_t> rejected_;
+	std::atomic<uint64_t> dequeued_;
+	std::atomic<uint64_t> depth_;
+	LatencyHistogram queueWait_;
+};
+
+/// <summary>
+/// 工作线程自己的计数器，只由所属线程写
+/// </summary>
+class alignas(64) WorkerCounters
+{
+public:
+	explicit WorkerCounters(int threadId)
+		: threadId_(threadId), completed_(0), busyNs_(0), idleNs_(0)
+	{}
+
+	// 一个任务执行完成
+	void taskDone(uint64_t queueWaitNs, uint64_t runNs, uint64_t idleNs)
+	{
+		completed_.store(completed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		busyNs_.store(busyNs_.load(std::memory_order_relaxed) + runNs, std::memory_order_relaxed);
+		idleNs_.store(idleNs_.load(std::memory_order_relaxed) + idleNs, std::memory_order_relaxed);
+		queueWait_.record(queueWaitNs);
+		runTime_.record(runNs);
+	}
+
+	// 汇总到快照中
+	void collect(PoolStats& stats, bool listWorker) const
+	{
+		WorkerStats worker{ threadId_,
+							completed_.load(std::memory_order_relaxed),
+							busyNs_.load(std::memory_order_relaxed),
+							idleNs_.load(std::memory_order_relaxed) };
+		stats.completed_ += worker.completed_;
+		stats.busyNs_ += worker.busyNs_;
+		stats.idleNs_ += worker.idleNs_;
+		queueWait_.collect(stats.queueWait_);
+		runTime_.collect(stats.runTime_);
+		if (listWorker)
+			stats.workers_.push_back(worker);
+	}
+
+private:
+	int threadId_;
+	std::atomic<uint64_t> completed_;
+	std::atomic<uint64_t> busyNs_;
+	std::atomic<uint64_t> idleNs_;
+	LatencyHistogram queueWait_;
+	LatencyHistogram runTime_;
+};
+
+/// <summary>
+/// 线程池统计的记录器，两种线程池共用
+/// </summary>
+class PoolStatsRecorder
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	PoolStatsRecorder()
+		: queueHighWater_(0), retiredCompleted_(0), retiredBusyNs_(0), retiredIdleNs_(0)
+	{
+		for (auto &stripe : stripes_)
+		{
+			stripe.submitted_.store(0, std::memory_order_relaxed);
+			stripe.rejected_.store(0, std::memory_order_relaxed);
+			stripe.cancelled_.store(0, std::memory_order_relaxed);
+			stripe.helped_.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	PoolStatsRecorder(const PoolStatsRecorder&) = delete;
+	PoolStatsRecorder& operator=(const PoolStatsRecorder&) = delete;
+
+	// 工作线程启动时登记，返回该线程自己的计数器
+	WorkerCounters* addWorker(int threadId)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto &counters = workers_[threadId];
+		counters = std::make_unique<WorkerCounters>(threadId);
+		return counters.get();
+	}
+
+	// 工作线程退出时注销，计数合并到已回收线程的汇总中
+	void retireWorker(int threadId)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto it = workers_.find(threadId);
+		if (it == workers_.end())
+			return;
+		PoolStats retired;
+		it->second->collect(retired, false);
+		retiredCompleted_ += retired.completed_;
+		retiredBusyNs_ += retired.busyNs_;
+		retiredIdleNs_ += retired.idleNs_;
+		retiredQueueWait_.merge(retired.queueWait_);
+		retiredRunTime_.merge(retired.runTime_);
+		workers_.erase(it);
+	}
+
+	// count个任务放入队列，depth为放入后排队的任务数量
+	void taskSubmitted(uint64_t count, uint64_t depth)
+	{
+		localStripe().submitted_.fetch_add(count, std::memory_order_relaxed);
+		uint64_t highWater = queueHighWater_.load(std::memory_order_relaxed);
+		while (depth > highWater
+			   && !queueHighWater_.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+		{}
+	}
+
+	// count个任务因为队列满提交失败
+	void taskRejected(uint64_t count)
+	{
+		localStripe().rejected_.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// count个任务取出时已经取消，没有执行
+	void taskCancelled(uint64_t count)
+	{
+		localStripe().cancelled_.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// count个任务由等待子任务的线程通过runPendingTask执行完成
+	// 执行时间已经算在等待的线程自己的任务中，这里只计入完成数量
+	void taskHelped(uint64_t count)
+	{
+		localStripe().helped_.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// 汇总所有计数器，线程数量和队列长度由线程池填写
+	void collect(PoolStats& stats) const
+	{
+		for (auto &stripe : stripes_)
+		{
+			stats.submitted_ += stripe.submitted_.load(std::memory_order_relaxed);
+			stats.rejected_ += stripe.rejected_.load(std::memory_order_relaxed);
+			stats.cancelled_ += stripe.cancelled_.load(std::memory_order_relaxed);
+			stats.completed_ += stripe.helped_.load(std::memory_order_relaxed);
+		}
+		stats.queueHighWater_ = queueHighWater_.load(std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(mtx_);
+		stats.completed_ += retiredCompleted_;
+		stats.busyNs_ += retiredBusyNs_;
+		stats.idleNs_ += retiredIdleNs_;
+		stats.queueWait_.merge(retiredQueueWait_);
+		stats.runTime_.merge(retiredRunTime_);
+		for (auto &item : workers_)
+		{
+			item.second->collect(stats, true);
+		}
+		std::sort(stats.workers_.begin(), stats.workers_.end(),
+				  [](const WorkerStats& a, const WorkerStats& b) { return a.threadId_ < b.threadId_; });
+	}
+
+	static uint64_t elapsedNs(Clock::time_point from, Clock::time_point to)
+	{
+		return to > from ? (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count() : 0;
+	}
+
+private:
+	// 提交任务的计数，每个缓存行一份，不同的提交线程大概率写不同的缓存行
+	struct alignas(64) Stripe
+	{
+		std::atomic<uint64_t> submitted_;
+		std::atomic<uint64_t> rejected_;
+		std::atomic<uint64_t> cancelled_;
+		std::atomic<uint64_t> helped_;
+	};
+
+	Stripe& localStripe()
+	{
+		thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % STATS_COUNTER_STRIPES;
+		return stripes_[index];
+	}
+
+	Stripe stripes_[STATS_COUNTER_STRIPES];
+	std::atomic<uint64_t> queueHighWater_;
+
+	mutable std::mutex mtx_;	// 保护下面的成员
+	std::unordered_map<int, std::unique_ptr<WorkerCounters>> workers_;
+	uint64_t retiredCompleted_;
+	uint64_t retiredBusyNs_;
+	uint64_t retiredIdleNs_;
+	HistogramSnapshot retiredQueueWait_;
+	HistogramSnapshot retiredRunTime_;
+};
+
+#endif // !POOLSTATS_H
@@ -0,0 +1,177 @@
+#ifndef PRIORITYQUEUE_H
+#define PRIORITYQUEUE_H
+
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+/// <summary>
+/// 任务优先级
+/// </summary>
+enum class TaskPriority
+{
+	PRIORITY_HIGH,	 // 延迟敏感的任务
+	PRIORITY_NORMAL, // 默认优先级
+	PRIORITY_LOW,	 // 后台批量任务
+};
+
+const int TASK_PRIORITY_LEVELS = 3;
+// 高优先级连续出队这么多次后，让积压的低优先级任务出队一次，防止低优先级任务饿死
+const int PRIORITY_STARVE_LIMIT = 16;
+
+/// <summary>
+/// 按优先级和截止时间排序的任务队列，需要外部加锁
+/// 每个优先级一个队列：有截止时间的任务按截止时间最早优先（EDF），没有截止时间的按先进先出，
+/// 同一优先级内有截止时间的任务先出队。不同优先级之间按优先级高低出队，
+/// 低优先级任务每被连续越过PRIORITY_STARVE_LIMIT次就保证出队一次
+/// </summary>
+template<typename T>
+class PriorityTaskQueue
+{
+public:
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	PriorityTaskQueue() : size_(0), seq_(0)
+	{
+		std::fill(starve_, starve_ + TASK_PRIORITY_LEVELS, 0);
+	}
+
+	// 放入任务，deadline为TimePoint::max()表示没有截止时间
+	void push(T item, TaskPriority priority, TimePoint deadline = TimePoint::max())
+	{
+		Level& level = levels_[(int)priority];
+		if (deadline == TimePoint::max())
+		{
+			level.fifo_.emplace(std::move(item));
+		}
+		else
+		{
+			level.edf_.push_back(Entry{ deadline, seq_++, std::move(item) });
+			std::push_heap(level.edf_.begin(), level.edf_.end(), laterFirst);
+		}
+		size_++;
+	}
+
+	// 取出下一个要执行的任务
+	bool pop(T& item)
+	{
+		int pick = -1;
+		// 优先照顾已经饿了很久的低优先级
+		for (int i = 1; i < TASK_PRIORITY_LEVELS; i++)
+		{
+			if (!levels_[i].empty() && starve_[i] >= PRIORITY_STARVE_LIMIT)
+			{
+				pick = i;
+				break;
+			}
+		}
+		if (pick < 0)
+		{
+			for (int i = 0; i < TASK_PRIORITY_LEVELS; i++)
+			{
+				if (!levels_[i].empty())
+				{
+					pick = i;
+					break;
+				}
+			}
+		}
+		if (pick < 0)
+			return false;
+
+		// 被越过的低优先级累计饥饿次数
+		starve_[pick] = 0;
+		for (int i = pick + 1; i < TASK_PRIORITY_LEVELS; i++)
+		{
+			if (!levels_[i].empty())
+				starve_[i]++;
+		}
+
+		Level& level = levels_[pick];
+		if (!level.edf_.empty())
+		{
+			std::pop_heap(level.edf_.begin(), level.edf_.end(), laterFirst);
+			item = std::move(level.edf_.back().item_);
+			level.edf_.pop_back();
+		}
+		else
+		{
+			item = std::move(level.fifo_.front());
+			level.fifo_.pop();
+		}
+		size_--;
+		return true;
+	}
+
+	// 取出最不紧急的任务：最低的非空优先级中，没有截止时间的最早任务，
+	// 都有截止时间时取截止时间最晚的任务。队列满需要丢弃任务时使用
+	bool popLeastUrgent(T& item)
+	{
+		for (int i = TASK_PRIORITY_LEVELS - 1; i >= 0; i--)
+		{
+			Level& level = levels_[i];
+			if (level.empty())
+				continue;
+			if (!level.fifo_.empty())
+			{
+				item = std::move(level.fifo_.front());
+				level.fifo_.pop();
+			}
+			else
+			{
+				auto latest = std::min_element(level.edf_.begin(), level.edf_.end(), laterFirst);
+				item = std::move(latest->item_);
+				level.edf_.erase(latest);
+				std::make_heap(level.edf_.begin(), level.edf_.end(), laterFirst);
+			}
+			size_--;
+			return true;
+		}
+		return false;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+private:
+	struct Entry
+	{
+		TimePoint deadline_;
+		uint64_t seq_;	// 截止时间相同时按放入顺序
+		T item_;
+	};
+
+	// 堆顶是截止时间最早的任务
+	static bool laterFirst(const Entry& a, const Entry& b)
+	{
+		if (a.deadline_ != b.deadline_)
+			return a.deadline_ > b.deadline_;
+		return a.seq_ > b.seq_;
+	}
+
+	struct Level
+	{
+		std::queue<T> fifo_;		// 没有截止时间的任务
+		std::vector<Entry> edf_;	// 有截止时间的任务，小顶堆
+		bool empty() const
+		{
+			return fifo_.empty() && edf_.empty();
+		}
+	};
+
+	Level levels_[TASK_PRIORITY_LEVELS];
+	int starve_[TASK_PRIORITY_LEVELS];	// 有任务但被更高优先级连续越过的次数
+	size_t size_;
+	uint64_t seq_;
+};
+
+#endif // !PRIORITYQUEUE_H
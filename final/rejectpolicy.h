@@ -0,0 +1,37 @@
+#ifndef REJECTPOLICY_H
+#define REJECTPOLICY_H
+
+#include <chrono>
+#include <stdexcept>
+
+/*
+任务队列满时的处理方式
+submitTask最多等待submitTimeout，submitFor最多等待给定的时间，之后仍然放不进队列就按拒绝策略处理；
+trySubmit不等待也不使用拒绝策略，放不进队列直接返回失败，由调用方决定是否重试或者降级
+*/
+
+/// <summary>
+/// 任务队列满、等待超时后的拒绝策略
+/// </summary>
+enum class RejectPolicy
+{
+	REJECT_FAIL,		// 提交失败，任务的结果对象报告TaskRejected异常
+	REJECT_CALLER_RUNS,	// 由提交任务的线程直接执行，自然地降低提交速度
+	REJECT_DROP_OLDEST,	// 丢弃队列中最早的任务（优先级队列中最不紧急的任务），放入新任务
+};
+
+// 提交任务默认的最长等待时间
+const auto SUBMIT_TIMEOUT = std::chrono::seconds(1);
+
+/// <summary>
+/// 任务被拒绝或者被丢弃，没有执行
+/// </summary>
+class TaskRejected : public std::runtime_error
+{
+public:
+	TaskRejected()
+		: std::runtime_error("task rejected: task queue is full")
+	{}
+};
+
+#endif // !REJECTPOLICY_H
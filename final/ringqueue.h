@@ -0,0 +1,131 @@
+#ifndef RINGQUEUE_H
+#define RINGQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// 有界多生产者多消费者无锁环形队列
+/// 槽位一次性预分配，每个槽位带一个序号，生产者和消费者各自用CAS推进写/读位置，
+/// 通过槽位序号交接数据，入队出队都不加锁、不分配内存
+/// </summary>
+template<typename T>
+class RingQueue
+{
+public:
+	// 容量向上取整为2的幂
+	explicit RingQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		mask_ = size - 1;
+		cells_ = std::make_unique<Cell[]>(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			cells_[i].seq_.store(i, std::memory_order_relaxed);
+		}
+		enqueuePos_.store(0, std::memory_order_relaxed);
+		dequeuePos_.store(0, std::memory_order_relaxed);
+	}
+	~RingQueue() = default;
+
+	RingQueue(const RingQueue&) = delete;
+	RingQueue& operator=(const RingQueue&) = delete;
+
+	// 放入元素，队列满时返回false，此时item不会被移走
+	bool push(T& item)
+	{
+		Cell* cell;
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->seq_.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+			if (dif == 0)
+			{
+				// 槽位空闲，抢占写位置
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+			{
+				// 槽位上一轮的数据还没被取走，队列满
+				return false;
+			}
+			else
+			{
+				// 其他生产者已经抢走这个位置
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->data_ = std::move(item);
+		cell->seq_.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 取出元素，队列空时返回false
+	bool pop(T& item)
+	{
+		Cell* cell;
+		size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->seq_.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (dif == 0)
+			{
+				// 槽位已写入数据，抢占读位置
+				if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+			{
+				// 槽位还没有写入数据，队列空
+				return false;
+			}
+			else
+			{
+				// 其他消费者已经抢走这个位置
+				pos = dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		item = std::move(cell->data_);
+		cell->data_ = T(); // 释放槽位中残留的资源
+		cell->seq_.store(pos + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 元素数量的近似值
+	size_t size() const
+	{
+		size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+		size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+		return enq > deq ? enq - deq : 0;
+	}
+
+	size_t capacity() const
+	{
+		return mask_ + 1;
+	}
+
+private:
+	// 槽位按缓存行对齐，相邻槽位的读写不会互相干扰
+	struct alignas(64) Cell
+	{
+		std::atomic<size_t> seq_;
+		T data_;
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	size_t mask_;
+	alignas(64) std::atomic<size_t> enqueuePos_; // 写位置，独占一个缓存行
+	alignas(64) std::atomic<size_t> dequeuePos_; // 读位置，独占一个缓存行
+	char pad_[64 - sizeof(std::atomic<size_t>)];
+};
+
+#endif // !RINGQUEUE_H
@@ -0,0 +1,177 @@
+#ifndef STATEPOOL_H
+#define STATEPOOL_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+/*
+任务结果共享状态的内存池
+每次提交需要结果的任务都要分配一个共享状态（std::promise的共享状态或者ResultState），
+结果被取走、最后一个引用释放后，内存块放回线程池自己的空闲链表，下一次提交直接复用，
+稳定运行时提交任务不再分配堆内存。
+空闲链表按线程分散到多个分段，共享状态通常由提交线程创建、也由提交线程在取完结果后释放，
+所以分配和回收大多落在同一个分段上，不同的提交线程之间几乎没有锁竞争
+*/
+
+// 内存块按这个粒度分成几种大小
+const size_t STATE_SIZE_STEP = 64;
+// 内存块的种类数量，更大的共享状态直接使用堆内存
+const int STATE_SIZE_CLASSES = 8;
+// 空闲链表分段的数量
+const int STATE_POOL_STRIPES = 16;
+// 每个分段每种大小最多保留的空闲内存块
+const size_t STATE_CACHE_LIMIT = 1024;
+
+/// <summary>
+/// 固定几种大小的内存块的空闲链表，线程安全
+/// </summary>
+class StatePool
+{
+public:
+	StatePool() = default;
+
+	~StatePool()
+	{
+		for (auto &stripe : stripes_)
+		{
+			for (auto &head : stripe.free_)
+			{
+				while (head != nullptr)
+				{
+					Block* next = head->next_;
+					::operator delete(head);
+					head = next;
+				}
+			}
+		}
+	}
+
+	StatePool(const StatePool&) = delete;
+	StatePool& operator=(const StatePool&) = delete;
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			return ::operator new(size, std::align_val_t(alignment));
+		int cls = sizeClass(size);
+		if (cls < 0)
+			return ::operator new(size);
+		Stripe& stripe = localStripe();
+		{
+			std::lock_guard<std::mutex> lock(stripe.mtx_);
+			Block* block = stripe.free_[cls];
+			if (block != nullptr)
+			{
+				stripe.free_[cls] = block->next_;
+				stripe.count_[cls]--;
+				return block;
+			}
+		}
+		return ::operator new((cls + 1) * STATE_SIZE_STEP);
+	}
+
+	void deallocate(void* p, size_t size, size_t alignment)
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			::operator delete(p, std::align_val_t(alignment));
+			return;
+		}
+		int cls = sizeClass(size);
+		if (cls >= 0)
+		{
+			Stripe& stripe = localStripe();
+			std::lock_guard<std::mutex> lock(stripe.mtx_);
+			if (stripe.count_[cls] < STATE_CACHE_LIMIT)
+			{
+				Block* block = static_cast<Block*>(p);
+				block->next_ = stripe.free_[cls];
+				stripe.free_[cls] = block;
+				stripe.count_[cls]++;
+				return;
+			}
+		}
+		::operator delete(p);
+	}
+
+private:
+	struct Block
+	{
+		Block* next_;
+	};
+
+	struct alignas(64) Stripe
+	{
+		std::mutex mtx_;
+		Block* free_[STATE_SIZE_CLASSES] = {};
+		size_t count_[STATE_SIZE_CLASSES] = {};
+	};
+
+	// 内存块的种类，不使用内存池时返回-1
+	static int sizeClass(size_t size)
+	{
+		if (size == 0 || size > STATE_SIZE_STEP * STATE_SIZE_CLASSES)
+			return -1;
+		return (int)((size - 1) / STATE_SIZE_STEP);
+	}
+
+	Stripe& localStripe()
+	{
+		thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % STATE_POOL_STRIPES;
+		return stripes_[index];
+	}
+
+	Stripe stripes_[STATE_POOL_STRIPES];
+};
+
+/// <summary>
+/// 从StatePool分配内存的分配器，用于std::promise和std::allocate_shared
+/// 分配器持有内存池的引用，线程池析构后还没释放的共享状态也能正确归还
+/// </summary>
+template<typename T>
+class StateAllocator
+{
+public:
+	using value_type = T;
+
+	explicit StateAllocator(std::shared_ptr<StatePool> pool)
+		: pool_(std::move(pool))
+	{}
+
+	template<typename U>
+	StateAllocator(const StateAllocator<U>& other)
+		: pool_(other.pool_)
+	{}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(pool_->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		pool_->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	friend bool operator==(const StateAllocator& a, const StateAllocator& b)
+	{
+		return a.pool_ == b.pool_;
+	}
+
+	friend bool operator!=(const StateAllocator& a, const StateAllocator& b)
+	{
+		return a.pool_ != b.pool_;
+	}
+
+private:
+	template<typename U>
+	friend class StateAllocator;
+
+	std::shared_ptr<StatePool> pool_;
+};
+
+#endif // !STATEPOOL_H
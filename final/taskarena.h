@@ -0,0 +1,210 @@
+#ifndef TASKARENA_H
+#define TASKARENA_H
+
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+
+/*
+工作线程私有的任务临时内存
+每个工作线程启动时创建一个TaskArena，任务中通过ThreadPool::localArena()拿到它，
+分配只是移动指针，释放什么也不做，任务结束后整体回收。
+回收时内存块不还给堆：这次用了多个内存块时合并成一个同样大小的块留给下一个任务，
+之后同样规模的任务只用一个块，不再访问全局堆。
+分配的内存只在任务执行期间有效，任务返回后（包括协程挂起后）不能再使用
+*/
+
+// 第一个内存块的大小
+const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+// 回收后最多保留的内存，偶尔一次特别大的任务不会让线程一直占着大块内存
+const size_t ARENA_MAX_RETAIN = 4 * 1024 * 1024;
+
+/// <summary>
+/// 只在一个线程中使用的bump分配器，作为std::pmr::memory_resource给pmr容器使用
+/// </summary>
+class TaskArena : public std::pmr::memory_resource
+{
+public:
+	TaskArena()
+		: head_(nullptr), cur_(nullptr), end_(nullptr), depth_(0)
+	{}
+
+	~TaskArena()
+	{
+		release();
+	}
+
+	TaskArena(const TaskArena&) = delete;
+	TaskArena& operator=(const TaskArena&) = delete;
+
+	// 回收所有已分配的内存
+	void reset()
+	{
+		if (head_ == nullptr)
+			return;
+		if (head_->next_ != nullptr || head_->size_ > ARENA_MAX_RETAIN)
+		{
+			size_t total = 0;
+			for (Chunk* chunk = head_; chunk != nullptr; chunk = chunk->next_)
+			{
+				total += chunk->size_;
+			}
+			release();
+			if (total <= ARENA_MAX_RETAIN)
+				addChunk(total);
+			return;
+		}
+		cur_ = data(head_);
+	}
+
+	// 当前持有的内存大小
+	size_t capacity() const
+	{
+		size_t total = 0;
+		for (Chunk* chunk = head_; chunk != nullptr; chunk = chunk->next_)
+		{
+			total += chunk->size_;
+		}
+		return total;
+	}
+
+	// 当前线程的TaskArena，不是线程池的工作线程时返回nullptr
+	static TaskArena* current()
+	{
+		return currentSlot();
+	}
+
+	/// <summary>
+	/// 工作线程的整个生命周期把arena设为当前线程的arena
+	/// </summary>
+	class ThreadScope
+	{
+	public:
+		explicit ThreadScope(TaskArena& arena)
+			: prev_(currentSlot())
+		{
+			currentSlot() = &arena;
+		}
+
+		~ThreadScope()
+		{
+			currentSlot() = prev_;
+		}
+
+		ThreadScope(const ThreadScope&) = delete;
+		ThreadScope& operator=(const ThreadScope&) = delete;
+
+	private:
+		TaskArena* prev_;
+	};
+
+	/// <summary>
+	/// 执行一个任务，最外层的任务结束时回收当前线程的arena
+	/// 任务中嵌套执行其他任务时，内层任务结束不会回收外层任务还在使用的内存
+	/// </summary>
+	class TaskScope
+	{
+	public:
+		TaskScope()
+			: arena_(currentSlot())
+		{
+			if (arena_ != nullptr)
+				arena_->depth_++;
+		}
+
+		~TaskScope()
+		{
+			if (arena_ != nullptr && --arena_->depth_ == 0)
+				arena_->reset();
+		}
+
+		TaskScope(const TaskScope&) = delete;
+		TaskScope& operator=(const TaskScope&) = delete;
+
+	private:
+		TaskArena* arena_;
+	};
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		char* p = alignUp(cur_, alignment);
+		if (cur_ == nullptr || bytes > (size_t)(end_ - p))
+		{
+			size_t next = head_ == nullptr ? ARENA_CHUNK_SIZE : head_->size_ * 2;
+			addChunk(std::max(next, bytes + alignment + sizeof(Chunk)));
+			p = alignUp(cur_, alignment);
+		}
+		cur_ = p + bytes;
+		return p;
+	}
+
+	// 只回收最后一次分配，其他内存等到任务结束时整体回收
+	void do_deallocate(void* p, size_t bytes, size_t) override
+	{
+		if (static_cast<char*>(p) + bytes == cur_)
+			cur_ = static_cast<char*>(p);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	// 内存块头部，数据紧跟在后面
+	struct alignas(std::max_align_t) Chunk
+	{
+		Chunk* next_;
+		size_t size_;	// 包括头部的大小
+	};
+
+	static char* data(Chunk* chunk)
+	{
+		return reinterpret_cast<char*>(chunk + 1);
+	}
+
+	static char* alignUp(char* p, size_t alignment)
+	{
+		uintptr_t value = reinterpret_cast<uintptr_t>(p);
+		return reinterpret_cast<char*>((value + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	void addChunk(size_t size)
+	{
+		Chunk* chunk = static_cast<Chunk*>(::operator new(size));
+		chunk->next_ = head_;
+		chunk->size_ = size;
+		head_ = chunk;
+		cur_ = data(chunk);
+		end_ = reinterpret_cast<char*>(chunk) + size;
+	}
+
+	void release()
+	{
+		while (head_ != nullptr)
+		{
+			Chunk* next = head_->next_;
+			::operator delete(head_);
+			head_ = next;
+		}
+		cur_ = nullptr;
+		end_ = nullptr;
+	}
+
+	static TaskArena*& currentSlot()
+	{
+		thread_local TaskArena* arena = nullptr;
+		return arena;
+	}
+
+private:
+	Chunk* head_;	// 正在使用的内存块，之前的内存块链在后面
+	char* cur_;		// 下一次分配的位置
+	char* end_;		// 正在使用的内存块的末尾
+	int depth_;		// 正在执行的嵌套任务层数
+};
+
+#endif // !TASKARENA_H
@@ -0,0 +1,282 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <future>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+
+#include "threadpool.h"
+
+/// <summary>
+/// 任务依赖图
+/// 先声明节点和依赖边，再交给线程池执行。节点的所有前驱都执行完成后才提交到线程池，
+/// 等待依赖的过程不占用任何线程。图建好后可以反复执行，每次执行只分配计数器，
+/// 同一个图也可以同时执行多次
+/// </summary>
+class TaskGraph
+{
+public:
+	TaskGraph() : graph_(std::make_shared<Graph>())
+	{}
+
+	// 添加节点，返回节点编号
+	int addNode(std::function<void()> func)
+	{
+		Graph& graph = mutableGraph();
+		graph.nodes_.push_back(Node{ std::move(func), {}, 0 });
+		graph.checked_ = false;
+		return (int)graph.nodes_.size() - 1;
+	}
+
+	// 添加依赖，from执行完成后才执行to
+	void addEdge(int from, int to)
+	{
+		Graph& graph = mutableGraph();
+		if (from < 0 || to < 0 || from >= (int)graph.nodes_.size() || to >= (int)graph.nodes_.size())
+		{
+			throw std::out_of_range("task graph node id out of range");
+		}
+		graph.nodes_[from].successors_.push_back(to);
+		graph.nodes_[to].inDegree_++;
+		graph.checked_ = false;
+	}
+
+	// 添加一个在from之后执行的节点
+	int then(int from, std::function<void()> func)
+	{
+		int id = addNode(std::move(func));
+		addEdge(from, id);
+		return id;
+	}
+
+	// 添加一个在froms全部执行完成后执行的节点
+	int whenAll(const std::vector<int>& froms, std::function<void()> func)
+	{
+		int id = addNode(std::move(func));
+		for (int from : froms)
+		{
+			addEdge(from, id);
+		}
+		return id;
+	}
+
+	// 节点数量
+	size_t size() const
+	{
+		return graph_->nodes_.size();
+	}
+
+	// 在线程池上执行一遍整个图，所有节点执行完成后future就绪
+	// 节点抛出的第一个异常通过future返回，出现异常后还没执行的节点不再执行；
+	// 节点被线程池拒绝时future报告TaskRejected，这个节点和之后的节点同样不再执行
+	std::future<void> run(ThreadPool& pool)
+	{
+		check();
+
+		auto state = std::make_shared<RunState>(graph_, pool);
+		std::future<void> result = state->promise_.get_future();
+		if (graph_->nodes_.empty())
+		{
+			state->promise_.set_value();
+			return result;
+		}
+
+		// 没有前驱的节点一次性批量提交，没放入的按拒绝策略处理
+		std::vector<ThreadPool::Task> tasks;
+		for (int root : graph_->roots_)
+		{
+			tasks.emplace_back(NodeTask(state, root));
+		}
+		pool.rejectTasks(tasks, pool.enqueueBatch(tasks, ThreadPool::waitDeadline(pool.submitTimeout_)));
+		return result;
+	}
+
+private:
+	struct Node
+	{
+		std::function<void()> func_;
+		std::vector<int> successors_;	// 依赖本节点的节点
+		int inDegree_;					// 前驱节点数量
+	};
+
+	struct Graph
+	{
+		std::vector<Node> nodes_;
+		std::vector<int> roots_;	// 没有前驱的节点
+		bool checked_ = false;		// 是否已经检查过环并计算了roots_
+	};
+
+	// 每次执行的状态
+	struct RunState
+	{
+		RunState(std::shared_ptr<const Graph> graph, ThreadPool& pool)
+			: graph_(std::move(graph))
+			, pool_(pool)
+			, pending_(new std::atomic_int[graph_->nodes_.size()])
+			, remaining_((int)graph_->nodes_.size())
+			, failed_(false)
+		{
+			for (size_t i = 0; i < graph_->nodes_.size(); i++)
+			{
+				pending_[i].store(graph_->nodes_[i].inDegree_, std::memory_order_relaxed);
+			}
+		}
+
+		std::shared_ptr<const Graph> graph_;
+		ThreadPool& pool_;
+		std::unique_ptr<std::atomic_int[]> pending_;	// 每个节点还没完成的前驱数量
+		std::atomic_int remaining_;						// 还没完成的节点数量
+		std::promise<void> promise_;
+		std::mutex mtx_;
+		std::exception_ptr error_;	// 第一个异常
+		std::atomic_bool failed_;
+	};
+
+	/// <summary>
+	/// 提交到线程池的节点，被拒绝或者被丢弃时记录原因，不执行这个节点并继续结束它的后继
+	/// </summary>
+	class NodeTask
+	{
+	public:
+		NodeTask(std::shared_ptr<RunState> state, int id)
+			: state_(std::move(state)), id_(id)
+		{}
+
+		void operator()()
+		{
+			runNode(std::move(state_), id_);
+		}
+
+		void discard(std::exception_ptr reason) noexcept
+		{
+			fail(*state_, std::move(reason));
+			runNode(std::move(state_), id_);
+		}
+
+	private:
+		std::shared_ptr<RunState> state_;
+		int id_;
+	};
+
+	// 记录第一个异常，之后还没执行的节点不再执行
+	static void fail(RunState& state, std::exception_ptr error)
+	{
+		std::unique_lock<std::mutex> lock(state.mtx_);
+		if (!state.error_)
+			state.error_ = std::move(error);
+		state.failed_ = true;
+	}
+
+	// 提交一个就绪的节点，队列满时按线程池的拒绝策略处理
+	static void submitNode(const std::shared_ptr<RunState>& state, int id)
+	{
+		ThreadPool& pool = state->pool_;
+		ThreadPool::Task task = NodeTask(state, id);
+		if (!pool.enqueueTask(task, TaskPriority::PRIORITY_NORMAL, ThreadPool::TimePoint::max(),
+							  ThreadPool::waitDeadline(pool.submitTimeout_)))
+		{
+			pool.rejectTask(task, TaskPriority::PRIORITY_NORMAL, ThreadPool::TimePoint::max());
+		}
+	}
+
+	// 执行一个节点，并提交所有因此就绪的后继节点
+	// 第一个就绪的后继直接在当前线程继续执行，省掉一次入队出队
+	static void runNode(std::shared_ptr<RunState> state, int id)
+	{
+		while (id >= 0)
+		{
+			const Node& node = state->graph_->nodes_[id];
+			if (!state->failed_)
+			{
+				try
+				{
+					node.func_();
+				}
+				catch (...)
+				{
+					fail(*state, std::current_exception());
+				}
+			}
+
+			int next = -1;
+			for (int succ : node.successors_)
+			{
+				if (state->pending_[succ].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					if (next < 0)
+						next = succ;
+					else
+						submitNode(state, succ);
+				}
+			}
+
+			if (state->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				if (state->error_)
+					state->promise_.set_exception(state->error_);
+				else
+					state->promise_.set_value();
+			}
+			id = next;
+		}
+	}
+
+	// 检查图中是否有环，并记录没有前驱的节点
+	void check()
+	{
+		if (graph_->checked_)
+			return;
+		Graph& graph = mutableGraph();
+		size_t size = graph.nodes_.size();
+		std::vector<int> inDegree(size);
+		std::vector<int> ready;
+		graph.roots_.clear();
+		for (size_t i = 0; i < size; i++)
+		{
+			inDegree[i] = graph.nodes_[i].inDegree_;
+			if (inDegree[i] == 0)
+			{
+				graph.roots_.push_back((int)i);
+				ready.push_back((int)i);
+			}
+		}
+
+		size_t visited = 0;
+		while (!ready.empty())
+		{
+			int id = ready.back();
+			ready.pop_back();
+			visited++;
+			for (int succ : graph.nodes_[id].successors_)
+			{
+				if (--inDegree[succ] == 0)
+					ready.push_back(succ);
+			}
+		}
+		if (visited != size)
+		{
+			throw std::logic_error("task graph has a cycle");
+		}
+		graph.checked_ = true;
+	}
+
+	// 修改图之前调用，图正在被某次执行使用时先复制一份，不影响正在进行的执行
+	Graph& mutableGraph()
+	{
+		if (graph_.use_count() > 1)
+		{
+			graph_ = std::make_shared<Graph>(*graph_);
+		}
+		return *graph_;
+	}
+
+private:
+	std::shared_ptr<Graph> graph_;
+};
+
+#endif // !TASKGRAPH_H
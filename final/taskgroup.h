@@ -0,0 +1,137 @@
+#ifndef TASKGROUP_H
+#define TASKGROUP_H
+
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <exception>
+
+#include "threadpool.h"
+#include "taskgroupstate.h"
+
+/// <summary>
+/// 子任务执行完成或者被丢弃时通知任务组，异常交给任务组，由wait抛出
+/// </summary>
+template<typename Func>
+class GroupTask
+{
+public:
+	GroupTask(std::shared_ptr<TaskGroupState> state, Func func)
+		: state_(std::move(state)), func_(std::move(func))
+	{}
+
+	GroupTask(GroupTask&&) = default;
+	GroupTask& operator=(GroupTask&&) = default;
+
+	void operator()()
+	{
+		try
+		{
+			CancellationToken token = state_->token();
+			CancellationToken::Scope scope(token);
+			func_();
+		}
+		catch (...)
+		{
+			state_->childAborted(std::current_exception());
+		}
+		state_->childFinished();
+	}
+
+	void discard(std::exception_ptr reason) noexcept
+	{
+		state_->childAborted(std::move(reason));
+		state_->childFinished();
+	}
+
+	// 任务组已经取消，还没开始执行的子任务直接丢弃
+	bool cancelled() const
+	{
+		return state_->isCancelled();
+	}
+
+private:
+	std::shared_ptr<TaskGroupState> state_;
+	Func func_;
+};
+
+/// <summary>
+/// 结构化的任务组：run提交子任务，wait等待所有子任务结束，cancel取消还没开始执行的子任务
+/// wait不阻塞当前线程，子任务没有全部结束时执行线程池中排队的任务（包括自己的子任务），
+/// 所以在工作线程中递归地拆分任务、等待子任务，固定数量的线程也能跑满而不会死锁。
+/// 子任务抛出的第一个异常由wait抛出，同时取消其他还没开始执行的子任务
+/// </summary>
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& pool)
+		: pool_(pool), state_(std::make_shared<TaskGroupState>())
+	{}
+
+	// 析构时等待还没结束的子任务，子任务的异常被忽略
+	~TaskGroup()
+	{
+		try
+		{
+			wait();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	// 提交子任务，子任务中可以通过CancellationToken::current()发现任务组已经取消
+	// 任务队列满时不等待也不使用拒绝策略，由当前线程直接执行子任务；任务组已经取消时不再提交
+	template<typename Func, typename... Args>
+	void run(Func&& func, Args&&... args)
+	{
+		if (state_->isCancelled())
+			return;
+		auto call = [func = std::forward<Func>(func),
+					 args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+		{
+			std::apply(std::move(func), std::move(args));
+		};
+		state_->childStarted();
+		ThreadPool::Task task = GroupTask<decltype(call)>(state_, std::move(call));
+		if (!pool_.enqueueTask(task, TaskPriority::PRIORITY_NORMAL, ThreadPool::TimePoint::max(),
+							   ThreadPool::TimePoint::min()))
+		{
+			task();
+		}
+	}
+
+	// 等待所有子任务结束，等待期间执行线程池中排队的任务；有子任务失败时抛出第一个异常
+	// 返回或者抛出之后任务组恢复到没有取消的状态，可以继续提交下一批子任务
+	void wait()
+	{
+		while (state_->pending())
+		{
+			if (!pool_.runPendingTask())
+				state_->waitForChildren();
+		}
+		std::exception_ptr error = state_->takeError();
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	// 取消任务组，还没开始执行的子任务不再执行，已经在执行的子任务可以轮询CancellationToken::current()提前结束
+	void cancel()
+	{
+		state_->cancel();
+	}
+
+	bool isCancelled() const
+	{
+		return state_->isCancelled();
+	}
+
+private:
+	ThreadPool& pool_;
+	std::shared_ptr<TaskGroupState> state_;
+};
+
+#endif // !TASKGROUP_H
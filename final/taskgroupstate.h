@@ -0,0 +1,130 @@
+#ifndef TASKGROUPSTATE_H
+#define TASKGROUPSTATE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+#include "cancellation.h"
+
+/*
+结构化任务组的共享状态，两种线程池的TaskGroup共用
+任务组记录还没完成的子任务数量、第一个失败的子任务的异常和整个组的取消状态。
+等待的线程不阻塞在子任务的结果上，而是通过线程池的runPendingTask执行排队的任务，
+在固定数量的线程上递归分治也不会因为所有线程都在等待子任务而死锁
+*/
+
+// 等待的子任务都在其他线程上执行、没有排队的任务可以执行时，阻塞这么久再去检查一次
+const auto TASKGROUP_HELP_INTERVAL = std::chrono::microseconds(500);
+
+/// <summary>
+/// 任务组和它的子任务共同持有的状态，子任务可能比任务组对象晚一点结束
+/// </summary>
+class TaskGroupState
+{
+public:
+	TaskGroupState()
+		: pending_(0)
+	{}
+
+	TaskGroupState(const TaskGroupState&) = delete;
+	TaskGroupState& operator=(const TaskGroupState&) = delete;
+
+	// 提交一个子任务之前登记
+	void childStarted()
+	{
+		pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 子任务执行完成或者被丢弃，最后一个子任务结束时唤醒等待的线程
+	void childFinished()
+	{
+		if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			cond_.notify_all();
+		}
+	}
+
+	// 子任务失败，只保留第一个异常，并取消还没开始执行的其他子任务
+	void childFailed(std::exception_ptr error)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (!error_)
+				error_ = std::move(error);
+		}
+		source_.cancel();
+	}
+
+	// 子任务因为reason没有执行或者没有正常结束；任务组已经取消时的TaskCancelled不算失败
+	void childAborted(std::exception_ptr reason)
+	{
+		if (source_.isCancelled())
+		{
+			try
+			{
+				std::rethrow_exception(reason);
+			}
+			catch (const TaskCancelled&)
+			{
+				return;
+			}
+			catch (...)
+			{
+			}
+		}
+		childFailed(std::move(reason));
+	}
+
+	// 是否还有没结束的子任务
+	bool pending() const
+	{
+		return pending_.load(std::memory_order_acquire) > 0;
+	}
+
+	// 没有可以帮忙执行的任务时阻塞等待，最多等待TASKGROUP_HELP_INTERVAL
+	void waitForChildren()
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		cond_.wait_for(lock, TASKGROUP_HELP_INTERVAL, [&]() -> bool { return !pending(); });
+	}
+
+	// 取出第一个失败的子任务的异常，取出后清空；失败或者cancel留下的取消状态换成新的，任务组可以继续使用
+	// 在所有子任务都已经结束之后调用，这时没有子任务还持有旧的取消状态
+	std::exception_ptr takeError()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		std::exception_ptr error = std::move(error_);
+		error_ = nullptr;
+		if (source_.isCancelled())
+			source_ = CancellationSource();
+		return error;
+	}
+
+	void cancel()
+	{
+		source_.cancel();
+	}
+
+	bool isCancelled() const
+	{
+		return source_.isCancelled();
+	}
+
+	CancellationToken token() const
+	{
+		return source_.token();
+	}
+
+private:
+	std::atomic_int pending_;		// 还没结束的子任务数量
+	std::mutex mtx_;				// 保护error_，并配合cond_等待
+	std::condition_variable cond_;	// 最后一个子任务结束时通知
+	std::exception_ptr error_;		// 第一个失败的子任务的异常
+	CancellationSource source_;		// 整个任务组的取消状态
+};
+
+#endif // !TASKGROUPSTATE_H
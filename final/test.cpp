@@ -51,7 +51,15 @@ int main()
 	cout << r2.get() << endl;
 	cout << r3.get() << endl;
 	cout << r4.get() << endl;
-	cout << r5.get() << endl;
+	// 任务队列满，等待超时后提交失败
+	try
+	{
+		cout << r5.get() << endl;
+	}
+	catch (const TaskRejected& e)
+	{
+		cout << e.what() << endl;
+	}
 
 	// packaged_task<int(int, int)> task(sum1);
 	// future<int> res = task.get_future();
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <queue>
+#include <deque>
 #include <memory>
 #include <atomic>
 #include <mutex>
@@ -12,10 +13,32 @@
 #include <unordered_map>
 #include <thread>
 #include <future>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "ringqueue.h"
+#include "inplacetask.h"
+#include "priorityqueue.h"
+#include "groupqueue.h"
+#include "tracer.h"
+#include "poolstats.h"
+#include "cputopology.h"
+#include "waitpolicy.h"
+#include "rejectpolicy.h"
+#include "cancellation.h"
+#include "taskarena.h"
+#include "statepool.h"
+#include "timerwheel.h"
+#include "iopoller.h"
 
 const int TASK_MAX_THRESHHOLD = 2; // INT32_MAX;
 const int THREAD_MAX_THRESHHOLD = 1024;
-const int THREAD_MAX_IDLE_TIME = 60;
+const int THREAD_MAX_IDLE_TIME = 60;  // cached模式下多出的线程连续空闲这么多秒才回收
+const auto CACHED_GROW_WAIT = std::chrono::milliseconds(1);  // 任务排队超过这个时间才增加线程
+const auto CACHED_CHECK_INTERVAL = std::chrono::milliseconds(1); // 有积压时管理线程检查的间隔
+const int RING_QUE_MAX_SIZE = 1 << 16; // 无锁任务队列的最大容量
+const int RING_PUSH_SPIN_COUNT = 64;   // 无锁任务队列满时，生产者阻塞前的自旋次数
 
 /// <summary>
 /// 线程池支持的模式
@@ -24,6 +47,318 @@ enum class PoolMode
 {
 	MODE_FIXED,	 // 固定数量的线程
 	MODE_CACHED, // 线程数量可动态增长
+	MODE_STEALING, // 工作窃取，每个线程拥有自己的任务队列
+};
+
+/// <summary>
+/// 任务队列的实现方式
+/// </summary>
+enum class TaskQueType
+{
+	QUEUE_LOCKED,	// std::queue + 互斥锁
+	QUEUE_LOCKFREE, // 预分配的无锁环形队列，只有需要阻塞等待时才加锁
+	QUEUE_PRIORITY, // 按优先级和截止时间出队的加锁队列
+	QUEUE_GROUPED,	// 每个任务分组一个队列，按分组权重轮转出队的加锁队列
+};
+
+/// <summary>
+/// 任务分组的句柄，由ThreadPool::addTenantGroup返回，提交任务时指定任务所属的分组
+/// </summary>
+struct TenantGroup
+{
+	int index_ = 0;	// 分组下标，默认构造的句柄是默认分组
+};
+
+/// <summary>
+/// 放入任务队列的任务，额外记录创建时间，用来统计任务的排队时间
+/// </summary>
+class QueuedTask
+{
+public:
+	QueuedTask() = default;
+
+	QueuedTask(std::nullptr_t) noexcept
+	{}
+
+	template<typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, QueuedTask>>>
+	QueuedTask(Func&& func)
+		: task_(std::forward<Func>(func))
+		, enqueueTime_(PoolStatsRecorder::Clock::now())
+	{}
+
+	QueuedTask(QueuedTask&&) = default;
+	QueuedTask& operator=(QueuedTask&&) = default;
+
+	// 执行任务
+	void operator()()
+	{
+		task_();
+	}
+
+	// 不执行就丢弃任务，任务的结果对象报告reason
+	void discard(std::exception_ptr reason) noexcept
+	{
+		task_.discard(std::move(reason));
+	}
+
+	// 任务已经取消，取出后应当丢弃
+	bool cancelled() const
+	{
+		return task_.cancelled();
+	}
+
+	PoolStatsRecorder::Clock::time_point enqueueTime() const
+	{
+		return enqueueTime_;
+	}
+
+	// 定时任务到期时重新记录放入队列的时间，排队时间不包括定时的延迟
+	void restamp(PoolStatsRecorder::Clock::time_point now)
+	{
+		enqueueTime_ = now;
+	}
+
+	friend bool operator==(const QueuedTask& task, std::nullptr_t) noexcept
+	{
+		return task.task_ == nullptr;
+	}
+
+	friend bool operator!=(const QueuedTask& task, std::nullptr_t) noexcept
+	{
+		return task.task_ != nullptr;
+	}
+
+private:
+	InplaceTask task_;
+	PoolStatsRecorder::Clock::time_point enqueueTime_;
+};
+
+/// <summary>
+/// 把函数的返回值或者异常设置到promise中的任务
+/// 任务没有执行就被丢弃时，promise设置为丢弃的原因，用户拿到的future可以区分出来
+/// </summary>
+template<typename RType, typename Func>
+class PromiseTask
+{
+public:
+	PromiseTask(std::promise<RType> promise, Func func)
+		: promise_(std::move(promise))
+		, func_(std::move(func))
+	{}
+
+	PromiseTask(PromiseTask&&) = default;
+
+	void operator()()
+	{
+		try
+		{
+			if constexpr (std::is_void_v<RType>)
+			{
+				func_();
+				promise_.set_value();
+			}
+			else
+			{
+				promise_.set_value(func_());
+			}
+		}
+		catch (...)
+		{
+			promise_.set_exception(std::current_exception());
+		}
+	}
+
+	void discard(std::exception_ptr reason)
+	{
+		promise_.set_exception(std::move(reason));
+	}
+
+private:
+	std::promise<RType> promise_;
+	Func func_;
+};
+
+/// <summary>
+/// post提交的任务，没有结果对象，任务抛出的异常没有地方报告，直接忽略
+/// </summary>
+template<typename Func>
+class PostTask
+{
+public:
+	explicit PostTask(Func func)
+		: func_(std::move(func))
+	{}
+
+	void operator()()
+	{
+		try
+		{
+			func_();
+		}
+		catch (...)
+		{
+		}
+	}
+
+private:
+	Func func_;
+};
+
+/// <summary>
+/// 带取消token的任务，工作线程取出时token已经取消就丢弃，结果对象报告TaskCancelled；
+/// 执行期间token设为当前线程的token，任务函数可以用CancellationToken::current()轮询
+/// </summary>
+template<typename Inner>
+class CancellableTask
+{
+public:
+	CancellableTask(CancellationToken token, Inner inner)
+		: token_(std::move(token))
+		, inner_(std::move(inner))
+	{}
+
+	void operator()()
+	{
+		CancellationToken::Scope scope(token_);
+		inner_();
+	}
+
+	void discard(std::exception_ptr reason)
+	{
+		inner_.discard(std::move(reason));
+	}
+
+	bool cancelled() const
+	{
+		return token_.isCancelled();
+	}
+
+private:
+	CancellationToken token_;
+	Inner inner_;
+};
+
+/// <summary>
+/// 在工作线程上恢复一个挂起的协程，co_await pool.schedule()放入队列的任务
+/// 任务被丢弃时把原因交给协程的等待对象，并在丢弃它的线程上恢复协程，由await_resume抛出异常，
+/// 协程不会一直挂起得不到恢复
+/// </summary>
+template<typename Handle>
+class ResumeTask
+{
+public:
+	ResumeTask(Handle handle, std::exception_ptr* error)
+		: handle_(handle)
+		, error_(error)
+	{}
+
+	void operator()()
+	{
+		handle_.resume();
+	}
+
+	void discard(std::exception_ptr reason)
+	{
+		*error_ = std::move(reason);
+		handle_.resume();
+	}
+
+private:
+	Handle handle_;
+	std::exception_ptr* error_;
+};
+
+class ThreadPool;
+
+/// <summary>
+/// 周期任务的状态，每一次执行的任务对象共用
+/// </summary>
+template<typename Call>
+struct PeriodicTimer
+{
+	CancellationToken token_;			// 取消后不再执行
+	std::chrono::nanoseconds period_;	// 执行周期
+	Call call_;
+};
+
+/// <summary>
+/// 周期任务的一次执行，执行完成后按周期安排下一次；被拒绝时跳过这一次，token取消后不再安排
+/// </summary>
+template<typename Call>
+class PeriodicTask
+{
+public:
+	PeriodicTask(ThreadPool* pool, std::shared_ptr<PeriodicTimer<Call>> timer,
+				 std::chrono::steady_clock::time_point due)
+		: pool_(pool)
+		, timer_(std::move(timer))
+		, due_(due)
+	{}
+
+	void operator()();
+
+	void discard(std::exception_ptr reason);
+
+	bool cancelled() const
+	{
+		return timer_->token_.isCancelled();
+	}
+
+private:
+	// 安排下一次执行，错过的周期直接跳过
+	void rearm();
+
+	ThreadPool* pool_;
+	std::shared_ptr<PeriodicTimer<Call>> timer_;
+	std::chrono::steady_clock::time_point due_;	// 这一次的到期时间
+};
+
+/// <summary>
+/// 工作窃取模式下线程私有的任务队列
+/// 所属线程从尾部存取任务（后进先出，缓存友好），其他线程从头部窃取任务
+/// </summary>
+template<typename T>
+class alignas(64) WorkStealingQueue
+{
+public:
+	// 所属线程放入任务
+	void push(T item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		que_.emplace_back(std::move(item));
+	}
+	// 所属线程取出最近放入的任务
+	bool pop(T& item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (que_.empty())
+			return false;
+		item = std::move(que_.back());
+		que_.pop_back();
+		return true;
+	}
+	// 所属线程批量放入任务，只加一次锁
+	void pushBatch(std::vector<T>& items)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		for (auto &item : items)
+		{
+			que_.emplace_back(std::move(item));
+		}
+	}
+	// 其他线程窃取最早放入的任务
+	bool steal(T& item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (que_.empty())
+			return false;
+		item = std::move(que_.front());
+		que_.pop_front();
+		return true;
+	}
+private:
+	std::deque<T> que_;
+	std::mutex mtx_;
 };
 
 /// <summary>
@@ -44,8 +379,12 @@ public:
 	// 启动线程
 	void start()
 	{
-		// 创建一个线程来执行线程函数
-		std::thread t(func_, threadId_);
+		// 创建一个线程来执行线程函数，线程拥有自己的任务临时内存
+		std::thread t([func = func_, threadId = threadId_]() {
+			TaskArena arena;
+			TaskArena::ThreadScope scope(arena);
+			func(threadId);
+		});
 		t.detach(); // 设置分离线程
 	}
 
@@ -67,208 +406,1570 @@ int Thread::generateId_ = 0;
 /// </summary>
 class ThreadPool
 {
+	// Task任务 =》 只能移动、小对象内联存储的函数对象，附带放入队列的时间
+	using Task = QueuedTask;
+
+	// 任务组直接提交带完成回调的任务对象
+	friend class TaskGroup;
+	// 任务图的节点被拒绝或者丢弃时要结束整个子图
+	friend class TaskGraph;
+	// 并行循环拆分区间时不等待任务队列空余，队列满就自己处理
+	template<typename Index, typename T, typename Map, typename Combine>
+	friend class ParallelReducer;
+	// 周期任务执行完成后重新加入时间轮
+	template<typename Call>
+	friend class PeriodicTask;
+
 public:
 	// 线程池构造
 	ThreadPool()
 		: initThreadSize_(0)
-		, taskSize_(0)
-		, idleThreadSize_(0)
 		, curThreadSize_(0)
-		, taskQueMaxThreshHold_(TASK_MAX_THRESHHOLD)
 		, threadSizeThreshHold_(THREAD_MAX_THRESHHOLD)
+		, idleThreadSize_(0)
+		, taskQueType_(TaskQueType::QUEUE_LOCKED)
+		, waitFullSize_(0)
+		, taskSize_(0)
+		, taskQueMaxThreshHold_(TASK_MAX_THRESHHOLD)
+		, workQueueSize_(0)
+		, affinityPolicy_(AffinityPolicy::AFFINITY_NONE)
+		, nextPlacement_(0)
+		, waitThreadSize_(0)
+		, waitPolicy_(WaitPolicy::WAIT_BLOCK)
+		, spinRounds_(WAIT_SPIN_ROUNDS)
+		, spinThreadSize_(0)
+		, rejectPolicy_(RejectPolicy::REJECT_FAIL)
+		, submitTimeout_(SUBMIT_TIMEOUT)
+		, statePool_(std::make_shared<StatePool>())
+		, nextTimerNs_(TimePoint::max().time_since_epoch().count())
+		, timerKeeper_(false)
+		, ioPolling_(false)
+		, managerSleeping_(false)
+		, retireSize_(0)
+		, peakBusySize_(0)
+		, lastQueueWaitNs_(0)
+		, lastDequeueNs_(0)
 		, poolMode_(PoolMode::MODE_FIXED)
 		, isPoolRunning_(false)
-	{}
+	{
+		// 0号分组是默认分组，不指定分组提交的任务都放在这里
+		groupQue_.addGroup("default", GROUP_DEFAULT_WEIGHT, 0);
+		groupCounters_.emplace_back(std::make_unique<GroupCounters>());
+	}
 	// 线程池析构
 	~ThreadPool()
 	{
 		isPoolRunning_ = false;
 
+		// 先停止管理线程，之后不会再创建新线程
+		if (manager_.joinable())
+		{
+			{
+				std::unique_lock<std::mutex> lock(managerMtx_);
+				managerCond_.notify_all();
+			}
+			manager_.join();
+		}
+
 		// 等待线程池里所有线程返回
 		std::unique_lock<std::mutex> lock(taskQueMtx_);
-		notEmpty_.notify_all();
+		wakeAllWaiters();
 		exitCond_.wait(lock, [&]() -> bool
 					{ return threads_.size() == 0; });
+		lock.unlock();
+
+		// 还没到期的定时任务不再执行
+		std::vector<Task> pending;
+		{
+			std::lock_guard<std::mutex> timerLock(timerMtx_);
+			timers_.clear(pending);
+		}
+		// 还在等待fd就绪的任务也不再执行
+		ioPoller_.clear(pending);
+		for (Task& task : pending)
+		{
+			task.discard(std::make_exception_ptr(TaskCancelled()));
+		}
 	}
  
 	// 设置线程池工作模式
+	// 运行中可以在fixed和cached之间切换：切到cached时启动管理线程，切回fixed时停止管理线程，
+	// 回收多于核心线程数量的线程；工作窃取模式的私有队列在start时创建，不能和其他模式互相切换
 	void setMode(PoolMode mode)
 	{
-		if (checkRunningState())
+		std::lock_guard<std::mutex> config(configMtx_);
+		if (!checkRunningState())
+		{
+			poolMode_ = mode;
 			return;
+		}
+		if (poolMode_ == mode || poolMode_ == PoolMode::MODE_STEALING || mode == PoolMode::MODE_STEALING)
+			return;
+
 		poolMode_ = mode;
+		if (mode == PoolMode::MODE_CACHED)
+		{
+			manager_ = std::thread(&ThreadPool::managerFunc, this);
+			return;
+		}
+		stopManager();
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		retireSize_ = std::max(curThreadSize_ - (int)initThreadSize_, 0);
+		if (retireSize_ > 0)
+			wakeAllWaiters();
 	}
 
-	// 设置任务队列上限阈值
+	// 设置任务队列上限阈值，运行中修改对之后的提交生效，已经排队的任务不受影响
+	// 无锁队列的容量在start时按阈值一次性分配，运行中调大阈值不会超过这个容量，调小阈值按任务数量检查
 	void setTaskQueMaxThreshHold(int threshhold)
 	{
-		if (checkRunningState())
-			return;
 		taskQueMaxThreshHold_ = threshhold;
+		if (!checkRunningState())
+			return;
+		// 阈值调大后唤醒等待队列空余的生产者
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		notFull_.notify_all();
 	}
 
-	// 设置线程池cached模式下线程阈值
-	void setThreadSizeThreshHold(int threshhold)
+	// 设置任务队列的实现方式
+	void setTaskQueType(TaskQueType type)
 	{
 		if (checkRunningState())
 			return;
-		if (poolMode_ == PoolMode::MODE_CACHED)
-		{
-			threadSizeThreshHold_ = threshhold;
-		}
+		taskQueType_ = type;
 	}
 
-	// 给线程池提交任务
-	// 使用可变参数模板编程，让submitTask可以接收任意函数和任意数量参数
-	template<typename Func, typename... Args>
-	auto submitTask(Func&& func, Args&&... args) -> std::future<decltype(func(args...))>
+	// 添加任务分组，只有QUEUE_GROUPED任务队列按分组出队，需要在start之前调用
+	// 有任务的分组按weight的比例轮流出队，maxSize为分组队列的上限，0表示使用任务队列阈值
+	// 一个分组积压再多任务也只占满自己的队列，不影响其他分组的提交和排队延迟
+	TenantGroup addTenantGroup(std::string name, int weight = GROUP_DEFAULT_WEIGHT, size_t maxSize = 0)
 	{
-		// 打包任务，放入任务队列
-		using RType = decltype(func(args...));
-		auto task = std::make_shared<std::packaged_task<RType()>>(
-			std::bind(std::forward<Func>(func), std::forward<Args>(args)...)
-		);
-		std::future<RType> result = task->get_future();
+		if (checkRunningState())
+			return TenantGroup();
+		int index = groupQue_.addGroup(std::move(name), weight, maxSize);
+		groupCounters_.emplace_back(std::make_unique<GroupCounters>());
+		return TenantGroup{ index };
+	}
 
-		// 获取锁
-		std::unique_lock<std::mutex> lock(taskQueMtx_);
+	// 设置工作线程空闲时的等待方式，spinRounds为阻塞前自旋的轮数，WAIT_BUSY_POLL时为检查回收和退出的间隔
+	void setWaitPolicy(WaitPolicy policy, int spinRounds = WAIT_SPIN_ROUNDS)
+	{
+		if (checkRunningState())
+			return;
+		waitPolicy_ = policy;
+		spinRounds_ = spinRounds;
+	}
 
-		// 用户提交任务，最长不能阻塞超过1s，否则判断任务提交
-		if (!notFull_.wait_for(lock, std::chrono::seconds(1),
-							[&]() -> bool
-							{ return taskQue_.size() < (size_t)taskQueMaxThreshHold_; }))
-		{
-			// 等待1s,条件依然没满足
-			std::cerr << "task queue is full, submit task fail" << std::endl;
-			auto task = std::make_shared<std::packaged_task<RType()>>(
-				[]()->RType{ return RType(); }
-			);
-			(*task)();
-			// return task->get_future(); 会报Broken Promise错误
-			std::future<RType> result = task->get_future();
-			return result;
-		}
+	// 设置任务队列满、等待超时后的拒绝策略
+	void setRejectPolicy(RejectPolicy policy)
+	{
+		if (checkRunningState())
+			return;
+		rejectPolicy_ = policy;
+	}
 
-		// 如果有空余，把任务放在任务队列中
-		// taskQue_.emplace(sp);
-		taskQue_.emplace([task](){ (*task)(); });
-		taskSize_++;
+	// 设置submitTask和submitBatch在任务队列满时最长的等待时间，超时后按拒绝策略处理
+	template<typename Rep, typename Period>
+	void setSubmitTimeout(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		if (checkRunningState())
+			return;
+		submitTimeout_ = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout);
+	}
 
-		// 新放了任务，任务队列肯定不空，notEmpty通知
-		notEmpty_.notify_all();
+	// 设置工作线程绑定CPU的方式，AFFINITY_LIST时cpus为CPU编号列表，线程依次绑定、循环使用
+	// 工作窃取模式下绑定CPU并且有多个NUMA节点时，每个节点一个任务队列，
+	// 外部线程提交的任务放入提交线程所在节点的队列，优先由该节点的线程执行
+	void setAffinity(AffinityPolicy policy, std::vector<int> cpus = {})
+	{
+		if (checkRunningState())
+			return;
+		affinityPolicy_ = policy;
+		affinityCpus_ = std::move(cpus);
+	}
 
-		// cached模式
-		if (poolMode_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ && curThreadSize_ < threadSizeThreshHold_)
+	// 使用给定的CPU拓扑代替自动检测，比如只使用部分NUMA节点
+	void setCpuTopology(CpuTopology topology)
+	{
+		if (checkRunningState())
+			return;
+		topology_ = std::make_unique<CpuTopology>(std::move(topology));
+	}
+
+	// 设置线程池cached模式下线程阈值，工作窃取模式下在start之前设置，是resize能达到的线程数量上限
+	void setThreadSizeThreshHold(int threshhold)
+	{
+		if (poolMode_ == PoolMode::MODE_CACHED || (poolMode_ == PoolMode::MODE_STEALING && !checkRunningState()))
 		{
-			// 创建新线程
-			auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-			int threadId = ptr->getId();
-			threads_.emplace(threadId, std::move(ptr));
-			// 启动线程
-			threads_[threadId]->start();
-			// 修改线程数量变量
-			curThreadSize_++;
-			idleThreadSize_++;
+			threadSizeThreshHold_ = threshhold;
 		}
+	}
 
-		return result;
+	// 当前线程池线程数量
+	int getThreadSize() const
+	{
+		return curThreadSize_;
 	}
 
-	// 开启线程池
-	void start(int initThreadSize = std::thread::hardware_concurrency())
+	// 当前没有在执行任务的线程数量
+	int getIdleThreadSize() const
 	{
-		// 设置线程池运行状态
-		isPoolRunning_ = true;
+		return idleThreadSize_;
+	}
 
-		// 记录线程初始个数
-		initThreadSize_ = initThreadSize;
-		curThreadSize_ = initThreadSize;
+	// 当前工作线程的任务临时内存，任务返回后自动回收，用于pmr容器，比如
+	// std::pmr::vector<int> buf(n, ThreadPool::localArena());
+	// 不在工作线程中时返回全局堆
+	static std::pmr::memory_resource* localArena()
+	{
+		TaskArena* arena = TaskArena::current();
+		if (arena != nullptr)
+			return arena;
+		return std::pmr::new_delete_resource();
+	}
 
-		// 创建线程对象
-		for (int i = 0; i < initThreadSize_; i++)
+	// 运行统计的快照，计数器在读取时才汇总
+	PoolStats getStats() const
+	{
+		PoolStats stats;
+		stats_.collect(stats);
+		stats.queueDepth_ = taskSize_;
+		stats.threadSize_ = curThreadSize_;
+		stats.idleThreadSize_ = idleThreadSize_;
+		if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
 		{
-			// 创建thread线程对象的时候，把线程函数给到线程对象
-			auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-			int threadId = ptr->getId();
-			threads_.emplace(threadId, std::move(ptr));
-			// threads_.emplace_back(std::move(ptr));
+			// 分组在start之后不再变化，不需要加锁
+			for (int i = 0; i < groupQue_.groupCount(); i++)
+			{
+				GroupStats group;
+				group.name_ = groupQue_.name(i);
+				group.weight_ = groupQue_.weight(i);
+				groupCounters_[i]->collect(group);
+				stats.groups_.emplace_back(std::move(group));
+			}
+		}
+		return stats;
+	}
+
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	// 给线程池提交任务
+	// 使用可变参数模板编程，让submitTask可以接收任意函数和任意数量参数
+	// 函数和参数按值移动到任务对象中保存，执行时参数以右值传给函数，支持只能移动的参数类型
+	// 任务队列满时最多等待submitTimeout，之后按拒绝策略处理
+	template<typename Func, typename... Args>
+	auto submitTask(Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitTaskWith(TaskPriority::PRIORITY_NORMAL, TimePoint::max(), submitTimeout_,
+							  std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 提交任务，任务队列满时最多等待timeout，之后按拒绝策略处理
+	template<typename Rep, typename Period, typename Func, typename... Args>
+	auto submitFor(const std::chrono::duration<Rep, Period>& timeout, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitTaskWith(TaskPriority::PRIORITY_NORMAL, TimePoint::max(),
+							  std::chrono::duration_cast<std::chrono::nanoseconds>(timeout),
+							  std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 尝试提交任务，从不阻塞；任务队列满时不使用拒绝策略，直接返回空，任务不会执行
+	template<typename Func, typename... Args>
+	auto trySubmit(Func&& func, Args&&... args)
+		-> std::optional<std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		Task task = packTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		if (!enqueueTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max(), TimePoint::min()))
+		{
+			stats_.taskRejected(1);
+			groupRejected(0);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+			return std::nullopt;
+		}
+		return result;
+	}
+
+	// 按优先级提交任务，只有QUEUE_PRIORITY任务队列会按优先级出队，其他队列按普通任务处理
+	template<typename Func, typename... Args>
+	auto submitTask(TaskPriority priority, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitTaskWith(priority, TimePoint::max(), submitTimeout_,
+							  std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 带截止时间提交任务，同一优先级中截止时间早的任务先出队
+	template<typename Func, typename... Args>
+	auto submitTask(TimePoint deadline, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitTaskWith(TaskPriority::PRIORITY_NORMAL, deadline, submitTimeout_,
+							  std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 同时指定优先级和截止时间提交任务
+	template<typename Func, typename... Args>
+	auto submitTask(TaskPriority priority, TimePoint deadline, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitTaskWith(priority, deadline, submitTimeout_,
+							  std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 提交任务到分组，只有QUEUE_GROUPED任务队列按分组出队，其他队列按普通任务处理
+	// 分组队列满时最多等待submitTimeout，之后按拒绝策略处理，REJECT_DROP_OLDEST只挤掉同一分组的任务
+	// 工作窃取模式下线程池内部线程提交的任务和普通任务一样放入该线程的私有队列
+	template<typename Func, typename... Args>
+	auto submitTask(TenantGroup group, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		Task task = packTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		if (!enqueueTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max(), waitDeadline(submitTimeout_), group.index_))
+		{
+			rejectTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max(), group.index_);
+		}
+		return result;
+	}
+
+	// 提交不需要结果的任务，不创建promise和future，提交路径上只有任务对象本身
+	// 任务抛出的异常被忽略；队列满时最多等待submitTimeout，之后按拒绝策略处理，任务被丢弃时返回false
+	template<typename Func, typename... Args>
+	bool post(Func&& func, Args&&... args)
+	{
+		auto call = [func = std::forward<Func>(func),
+					 args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+		{
+			std::apply(std::move(func), std::move(args));
+		};
+		Task task = PostTask<decltype(call)>(std::move(call));
+		if (enqueueTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max(), waitDeadline(submitTimeout_)))
+			return true;
+		return rejectTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max());
+	}
+
+	// 带取消token提交任务，同一次请求的任务共用一个CancellationSource的token，可以一起取消
+	// 取出时已经取消或者超过token的截止时间的任务不执行，future报告TaskCancelled；
+	// QUEUE_PRIORITY任务队列把token的截止时间作为任务的截止时间，快要过期的任务先出队
+	template<typename Func, typename... Args>
+	auto submitTask(CancellationToken token, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		TimePoint deadline = token.deadline();
+		auto inner = makePromiseTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		Task task = CancellableTask<decltype(inner)>(std::move(token), std::move(inner));
+		if (!enqueueTask(task, TaskPriority::PRIORITY_NORMAL, deadline, waitDeadline(submitTimeout_)))
+		{
+			rejectTask(task, TaskPriority::PRIORITY_NORMAL, deadline);
+		}
+		return result;
+	}
+
+	// 延迟delay之后执行任务，到期后和普通任务一样放入任务队列，等待期间不占用工作线程
+	// 线程池没有运行时future报告TaskRejected，线程池析构时还没到期的任务报告TaskCancelled
+	template<typename Rep, typename Period, typename Func, typename... Args>
+	auto scheduleAfter(const std::chrono::duration<Rep, Period>& delay, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		Task task = packTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		if (!addTimer(task, waitDeadline(std::chrono::duration_cast<std::chrono::nanoseconds>(delay))))
+			dropTask(task);
+		return result;
+	}
+
+	// 每隔period执行一次任务，第一次在period之后执行；上一次执行完才安排下一次，不会重叠执行，
+	// 执行时间超过周期时跳过错过的周期。token取消后不再执行，任务抛出的异常被忽略；
+	// 队列满被拒绝时只跳过这一次。period不是正数或者线程池没有运行时返回false
+	template<typename Rep, typename Period, typename Func, typename... Args>
+	bool scheduleEvery(const std::chrono::duration<Rep, Period>& period, CancellationToken token, Func&& func, Args&&... args)
+	{
+		auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(period);
+		if (interval <= std::chrono::nanoseconds::zero())
+			return false;
+		// 每次执行都要再调用一次，函数和参数不移动
+		auto call = [func = std::forward<Func>(func),
+					 args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+		{
+			std::apply(func, args);
+		};
+		auto timer = std::make_shared<PeriodicTimer<decltype(call)>>(
+			PeriodicTimer<decltype(call)>{ std::move(token), interval, std::move(call) });
+		return armPeriodic(std::move(timer), waitDeadline(interval));
+	}
+
+	// 每隔period执行一次任务，不能取消，线程池析构时停止
+	template<typename Rep, typename Period, typename Func, typename... Args>
+	bool scheduleEvery(const std::chrono::duration<Rep, Period>& period, Func&& func, Args&&... args)
+	{
+		return scheduleEvery(period, CancellationToken(), std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// fd可读时执行任务，等待期间不占用工作线程，就绪后和普通任务一样放入任务队列
+	// 只触发一次，需要继续等待时在任务中再次提交；对端关闭或者出错也算就绪，由任务自己读出结果。
+	// 线程池没有运行、fd上已经有任务在等待可读或者fd不支持epoll时future报告TaskRejected，
+	// 线程池析构或者cancelIo时还在等待的任务报告TaskCancelled
+	template<typename Func, typename... Args>
+	auto submitOnReadable(int fd, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitOnReady(fd, IoEvent::IO_READABLE, std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// fd可写时执行任务，规则和submitOnReadable相同，同一个fd可以同时等待可读和可写
+	template<typename Func, typename... Args>
+	auto submitOnWritable(int fd, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		return submitOnReady(fd, IoEvent::IO_WRITABLE, std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 取消fd上还在等待的任务并报告TaskCancelled，返回取消的任务数量
+	// 关闭fd之前要调用，否则fd号码被复用之前等待的任务不会执行
+	size_t cancelIo(int fd)
+	{
+		std::vector<Task> cancelled;
+		ioPoller_.cancel(fd, cancelled);
+		for (Task& task : cancelled)
+		{
+			task.discard(std::make_exception_ptr(TaskCancelled()));
+		}
+		return cancelled.size();
+	}
+
+	// 批量提交任务，区间中的每个元素是一个无参的可调用对象
+	// 所有任务在一次加锁中放入任务队列，并且只唤醒需要的线程数量；
+	// 队列满时整批最多等待submitTimeout，没放入的任务按拒绝策略处理
+	template<typename Iter>
+	auto submitBatch(Iter first, Iter last)
+		-> std::vector<std::future<std::invoke_result_t<std::decay_t<decltype(*first)>>>>
+	{
+		using Func = std::decay_t<decltype(*first)>;
+		using RType = std::invoke_result_t<Func>;
+		std::vector<std::future<RType>> results;
+		std::vector<Task> tasks;
+		for (; first != last; ++first)
+		{
+			std::promise<RType> promise = newPromise<RType>();
+			results.emplace_back(promise.get_future());
+			tasks.emplace_back(PromiseTask<RType, Func>(std::move(promise), Func(*first)));
+		}
+		rejectTasks(tasks, enqueueBatch(tasks, waitDeadline(submitTimeout_)));
+		return results;
+	}
+
+	// 批量提交任务，对下标区间[first, last)中的每个下标i执行func(i)
+	// 所有任务共享同一份函数对象
+	template<typename Func, typename Index>
+	auto submitBatch(Func&& func, Index first, Index last)
+		-> std::vector<std::future<std::invoke_result_t<std::decay_t<Func>&, Index>>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>&, Index>;
+		auto shared = std::make_shared<std::decay_t<Func>>(std::forward<Func>(func));
+		std::vector<std::future<RType>> results;
+		std::vector<Task> tasks;
+		for (Index i = first; i < last; ++i)
+		{
+			std::promise<RType> promise = newPromise<RType>();
+			results.emplace_back(promise.get_future());
+			auto call = [shared, i]() -> RType { return (*shared)(i); };
+			tasks.emplace_back(PromiseTask<RType, decltype(call)>(std::move(promise), std::move(call)));
+		}
+		rejectTasks(tasks, enqueueBatch(tasks, waitDeadline(submitTimeout_)));
+		return results;
+	}
+
+	/// <summary>
+	/// co_await pool.schedule() 挂起当前协程，由线程池的工作线程恢复执行
+	/// 恢复操作和普通任务放入同一个任务队列，由同样的工作线程执行；
+	/// 队列满时和submitTask一样等待submitTimeout并按拒绝策略处理：
+	/// REJECT_CALLER_RUNS在当前线程继续执行，REJECT_FAIL在当前线程继续并由co_await抛出TaskRejected
+	/// 不依赖<coroutine>头文件，C++17编译时也可以包含本文件，协程相关的类型见coroutine.h
+	/// </summary>
+	class ScheduleAwaiter
+	{
+	public:
+		explicit ScheduleAwaiter(ThreadPool& pool)
+			: pool_(pool)
+		{}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		// 返回false表示不挂起，协程在当前线程继续执行
+		template<typename Handle>
+		bool await_suspend(Handle handle)
+		{
+			return pool_.scheduleResume(handle, &error_);
+		}
+
+		void await_resume()
+		{
+			if (error_)
+				std::rethrow_exception(error_);
+		}
+
+	private:
+		ThreadPool& pool_;
+		std::exception_ptr error_;	// 恢复任务被拒绝或者丢弃的原因
+	};
+
+	ScheduleAwaiter schedule()
+	{
+		return ScheduleAwaiter(*this);
+	}
+
+	// 在当前线程执行一个排队的任务，没有可以执行的任务时返回false
+	// 等待子任务的线程用它代替阻塞：工作线程先执行自己私有队列中的任务，再去共享队列和其他线程的队列中获取
+	bool runPendingTask()
+	{
+		Task task;
+		if (!takePendingTask(task))
+			return false;
+		if (discardCancelled(task))
+			return true;
+		// 帮忙取走的任务同样说明积压在减少，cached模式下不会因此多创建线程
+		if (poolMode_ == PoolMode::MODE_CACHED)
+			recordCachedLoad(PoolStatsRecorder::Clock::now(), task.enqueueTime());
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_START);
+		{
+			TaskArena::TaskScope scope;
+			task();
+		}
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_END);
+		stats_.taskHelped(1);
+		return true;
+	}
+
+	// 开启线程池
+	void start(int initThreadSize = std::thread::hardware_concurrency())
+	{
+		// 设置线程池运行状态
+		isPoolRunning_ = true;
+
+		// 记录线程初始个数
+		initThreadSize_ = initThreadSize;
+		curThreadSize_ = initThreadSize;
+
+		// 无锁队列按照任务队列阈值一次性分配
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			ringQue_ = std::make_unique<RingQueue<Task>>(std::min<int>(taskQueMaxThreshHold_, RING_QUE_MAX_SIZE));
+		}
+
+		// 计算每个线程绑定的CPU
+		initPlacements();
+
+		// 工作窃取模式按线程数量上限预留私有队列的位置，resize增加线程时不会移动已有的队列
+		if (poolMode_ == PoolMode::MODE_STEALING)
+		{
+			workQueues_.reserve(std::max<int>(initThreadSize_, threadSizeThreshHold_));
+			workerNodes_.reserve(workQueues_.capacity());
+		}
+
+		// 创建线程对象
+		for (int i = 0; i < initThreadSize_; i++)
+		{
+			// 创建thread线程对象的时候，把线程函数给到线程对象
+			std::unique_ptr<Thread> ptr;
+			if (poolMode_ == PoolMode::MODE_STEALING)
+			{
+				ptr = std::make_unique<Thread>(std::bind(&ThreadPool::stealThreadFunc, this, std::placeholders::_1, newWorkQueue()));
+			}
+			else
+			{
+				ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+			}
+			int threadId = ptr->getId();
+			threads_.emplace(threadId, std::move(ptr));
+			// threads_.emplace_back(std::move(ptr));
+		}
+
+		// 启动所有线程，线程id是全局生成的，不一定从0开始
+		for (auto &item : threads_)
+		{
+			item.second->start();
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_SPAWN, item.first);
+			idleThreadSize_++;
+		}
+
+		// cached模式由管理线程负责增减线程
+		if (poolMode_ == PoolMode::MODE_CACHED)
+		{
+			manager_ = std::thread(&ThreadPool::managerFunc, this);
+		}
+	}
+
+	// 运行中调整线程数量，cached模式下调整的是核心线程数量，管理线程不会回收到这个数量以下
+	// 增加线程时先取消还没执行的回收，再创建新线程；减少线程时空闲的线程马上退出，
+	// 正在执行任务的线程执行完当前任务后退出，排队的任务和正在执行的任务都不受影响。
+	// 工作窃取模式下退出的线程留下的私有队列由其他线程窃取，新线程复用这些队列，
+	// 线程数量不能超过start时的线程数量上限（setThreadSizeThreshHold）。
+	// 线程池没有启动或者线程数量超出范围时返回false
+	bool resize(int threadSize)
+	{
+		std::lock_guard<std::mutex> config(configMtx_);
+		if (!checkRunningState() || threadSize < 1)
+			return false;
+		if (poolMode_ == PoolMode::MODE_STEALING && threadSize > (int)workQueues_.capacity())
+			return false;
+
+		initThreadSize_ = threadSize;
+		int count = 0;
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			int live = curThreadSize_ - retireSize_;
+			if (live > threadSize)
+			{
+				retireSize_ += live - threadSize;
+				wakeAllWaiters();
+			}
+			else
+			{
+				count = threadSize - live;
+				// 已经登记回收的线程还没退出，直接取消回收就够了
+				int cancel = std::min<int>(retireSize_, count);
+				retireSize_ -= cancel;
+				count -= cancel;
+			}
+		}
+		if (count > 0)
+			addThreads(count);
+		return true;
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+private:
+	// 共享状态从线程池的内存池分配的promise，结果取走后内存回到内存池
+	template<typename RType>
+	std::promise<RType> newPromise()
+	{
+		return std::promise<RType>(std::allocator_arg, StateAllocator<char>(statePool_));
+	}
+
+	// 把函数和参数打包成任务，result为任务的结果
+	template<typename Func, typename... Args>
+	Task packTask(std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>& result,
+						 Func&& func, Args&&... args)
+	{
+		return makePromiseTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+	}
+
+	// 把函数和参数打包成PromiseTask，还没有类型擦除，可以再套一层
+	template<typename Func, typename... Args>
+	auto makePromiseTask(std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>& result,
+								Func&& func, Args&&... args)
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::promise<RType> promise = newPromise<RType>();
+		result = promise.get_future();
+		auto call = [func = std::forward<Func>(func),
+					 args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> RType
+		{
+			return std::apply(std::move(func), std::move(args));
+		};
+		return PromiseTask<RType, decltype(call)>(std::move(promise), std::move(call));
+	}
+
+	// 打包任务，按照优先级和截止时间放入任务队列，队列满时最多等待timeout，之后按拒绝策略处理
+	template<typename Func, typename... Args>
+	auto submitTaskWith(TaskPriority priority, TimePoint deadline, std::chrono::nanoseconds timeout,
+						Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		Task task = packTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		if (!enqueueTask(task, priority, deadline, waitDeadline(timeout)))
+		{
+			rejectTask(task, priority, deadline);
+		}
+		return result;
+	}
+
+	// 把恢复协程的任务放入任务队列，返回false表示没有放入队列，协程在当前线程继续执行
+	template<typename Handle>
+	bool scheduleResume(Handle handle, std::exception_ptr* error)
+	{
+		Task task = ResumeTask<Handle>(handle, error);
+		if (enqueueTask(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max(), waitDeadline(submitTimeout_)))
+			return true;
+		if (rejectPolicy_ == RejectPolicy::REJECT_DROP_OLDEST
+			&& replaceOldest(task, TaskPriority::PRIORITY_NORMAL, TimePoint::max()))
+			return true;
+
+		// 不在这里执行或丢弃恢复任务，而是让协程不挂起，直接在当前线程继续执行
+		stats_.taskRejected(1);
+		groupRejected(0);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+		if (rejectPolicy_ != RejectPolicy::REJECT_CALLER_RUNS)
+			*error = std::make_exception_ptr(TaskRejected());
+		return false;
+	}
+
+	// 等待timeout对应的时间点，timeout过长时一直等待
+	static TimePoint waitDeadline(std::chrono::nanoseconds timeout)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (timeout >= TimePoint::max() - now)
+			return TimePoint::max();
+		return now + timeout;
+	}
+
+	// 按拒绝策略处理没能放入任务队列的任务，任务被丢弃时返回false
+	bool rejectTask(Task& task, TaskPriority priority, TimePoint deadline, int group = 0)
+	{
+		if (rejectPolicy_ == RejectPolicy::REJECT_DROP_OLDEST && replaceOldest(task, priority, deadline, group))
+			return true;
+
+		stats_.taskRejected(1);
+		groupRejected(group);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+		if (rejectPolicy_ == RejectPolicy::REJECT_CALLER_RUNS)
+		{
+			// 由提交任务的线程执行
+			if (!discardCancelled(task))
+				task();
+			return true;
+		}
+		task.discard(std::make_exception_ptr(TaskRejected()));
+		return false;
+	}
+
+	// 批量提交时从下标done开始没能放入队列的任务，逐个按拒绝策略处理
+	void rejectTasks(std::vector<Task>& tasks, size_t done)
+	{
+		for (size_t i = done; i < tasks.size(); i++)
+		{
+			rejectTask(tasks[i], TaskPriority::PRIORITY_NORMAL, TimePoint::max());
+		}
+	}
+
+	// 记录一个任务没能放入分组队列，只有QUEUE_GROUPED任务队列有分组统计
+	void groupRejected(int group)
+	{
+		if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+			groupCounters_[group]->taskRejected();
+	}
+
+	// 丢弃共享任务队列中最早的任务，把task放进去，共享队列已经空了或者被其他生产者抢先占满时返回false
+	// 分组队列丢弃的是同一分组中最早的任务
+	bool replaceOldest(Task& task, TaskPriority priority, TimePoint deadline, int group = 0)
+	{
+		Task victim;	// 在锁外丢弃，结果对象的回调不会在持有锁时执行
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			bool ok = ringPush(task);
+			if (!ok && popTask(victim))
+				ok = ringPush(task);
+			if (ok)
+			{
+				stats_.taskSubmitted(1, taskSize_);
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+				wakeWorkersUnlocked(1);
+			}
+			dropTask(victim);
+			return ok;
+		}
+
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		if (lockedQueFull(group))
+		{
+			if (taskQueType_ == TaskQueType::QUEUE_PRIORITY)
+			{
+				priQue_.popLeastUrgent(victim);
+			}
+			else if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+			{
+				if (groupQue_.popFront(victim, group))
+					groupCounters_[group]->taskEvicted();
+			}
+			else
+			{
+				victim = std::move(taskQue_.front());
+				taskQue_.pop();
+			}
+			if (victim != nullptr)
+				taskSize_--;
+		}
+		if (lockedQueFull(group))
+			return false;
+		lockedQuePush(std::move(task), priority, deadline, group);
+		stats_.taskSubmitted(1, ++taskSize_);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+		wakeWorkers(1);
+		lock.unlock();
+		dropTask(victim);
+		return true;
+	}
+
+	// 丢弃被新任务挤出队列的任务
+	void dropTask(Task& victim)
+	{
+		if (victim == nullptr)
+			return;
+		stats_.taskRejected(1);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+		victim.discard(std::make_exception_ptr(TaskRejected()));
+	}
+
+	// 唤醒所有阻塞等待任务的线程，包括在epoll_wait中等待fd就绪的线程，调用方需要持有taskQueMtx_
+	void wakeAllWaiters()
+	{
+		notEmpty_.notify_all();
+		if (ioPolling_)
+			ioPoller_.wake();
+	}
+
+	// 唤醒count个阻塞等待任务的线程，调用方需要持有taskQueMtx_
+	// 自旋中的线程会自己发现新任务，只唤醒它们处理不过来的部分
+	void wakeWorkers(size_t count)
+	{
+		size_t spinning = spinThreadSize_;
+		if (count <= spinning)
+			return;
+		count -= spinning;
+		// 在epoll_wait中的线程也计入waitThreadSize_，count小于它时条件变量上的线程就够了
+		if (count >= (size_t)waitThreadSize_)
+		{
+			wakeAllWaiters();
+		}
+		else
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				notEmpty_.notify_one();
+			}
+		}
+	}
+
+	// 不持有taskQueMtx_时唤醒count个线程，没有线程阻塞等待就不加锁
+	void wakeWorkersUnlocked(size_t count)
+	{
+		if (count > (size_t)spinThreadSize_ && waitThreadSize_ > 0)
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			wakeWorkers(count);
+		}
+	}
+
+	// cached模式下有积压并且没有空闲线程时唤醒管理线程，由管理线程根据排队时间决定是否增加线程
+	// 提交任务的线程自己不创建线程，调用时也不持有任务队列的锁
+	void wakeManagerIfBusy()
+	{
+		if (poolMode_ != PoolMode::MODE_CACHED || idleThreadSize_ > 0 || taskSize_ == 0)
+			return;
+		// 与管理线程登记睡眠后检查任务数量的顺序相反，保证唤醒不会丢失
+		if (managerSleeping_ && managerSleeping_.exchange(false))
+		{
+			std::unique_lock<std::mutex> lock(managerMtx_);
+			managerCond_.notify_one();
+		}
+	}
+
+	// 批量把任务放入任务队列，队列满时最多等待到waitUntil，返回成功放入的任务数量，没放入的总是排在最后
+	size_t enqueueBatch(std::vector<Task>& tasks, TimePoint waitUntil)
+	{
+		size_t count = tasks.size();
+		if (count == 0)
+			return 0;
+
+		// 工作窃取模式下，线程池内部线程提交的任务直接放入该线程的私有队列
+		if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
+		{
+			// 先增加任务数量再放入队列，其他线程取出任务后减少数量时不会减到0以下
+			unsigned depth = taskSize_ += count;
+			workQueues_[curQueueIndex_]->pushBatch(tasks);
+			stats_.taskSubmitted(count, depth);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, count);
+			wakeWorkersUnlocked(count);
+			return count;
+		}
+
+		// 按NUMA节点分队列时，外部批量提交的任务一起放入提交线程所在节点的队列
+		if (!nodeQueues_.empty() && reserveTaskSize(count))
+		{
+			nodeQueues_[submitNode()]->pushBatch(tasks);
+			stats_.taskSubmitted(count, taskSize_ += count);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, count);
+			wakeWorkersUnlocked(count);
+			return count;
+		}
+
+		size_t done = 0;
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			size_t woken = 0;
+			for (; done < count; done++)
+			{
+				if (ringPush(tasks[done]))
+				{
+					stats_.taskSubmitted(1, taskSize_);
+					continue;
+				}
+				// 队列满，先唤醒线程消费已经放入的任务，再按单个任务的方式等待队列空余
+				wakeWorkersUnlocked(done - woken);
+				if (!enqueueRingTask(tasks[done], waitUntil))
+					break;
+				woken = done + 1;
+			}
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, done);
+			wakeWorkersUnlocked(done - woken);
+			wakeManagerIfBusy();
+			return done;
+		}
+
+		// 获取锁
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		while (done < count)
+		{
+			// 线程通信  等待任务队列有空余，整批最多等待到waitUntil
+			if (!notFull_.wait_until(lock, waitUntil,
+								[&]() -> bool
+								{ return !lockedQueFull(0); }))
+			{
+				break;
+			}
+
+			// 把能放下的任务一次性放入队列
+			size_t begin = done;
+			while (done < count && !lockedQueFull(0))
+			{
+				lockedQuePush(std::move(tasks[done++]), TaskPriority::PRIORITY_NORMAL, TimePoint::max());
+				taskSize_++;
+			}
+			stats_.taskSubmitted(done - begin, taskSize_);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, done - begin);
+			wakeWorkers(done - begin);
+		}
+
+		lock.unlock();
+		wakeManagerIfBusy();
+		return done;
+	}
+
+	// NUMA节点队列放入count个任务之前登记任务数量，超过阈值时撤销登记并返回false
+	// 先登记再放入队列，窃取任务的线程减少任务数量时不会减到0以下
+	bool reserveTaskSize(size_t count)
+	{
+		if (taskSize_.fetch_add((unsigned)count) + count <= (size_t)taskQueMaxThreshHold_)
+			return true;
+		taskSize_ -= (unsigned)count;
+		return false;
+	}
+
+	// 加锁任务队列中的任务数量，调用方需要持有taskQueMtx_
+	size_t lockedQueSize() const
+	{
+		if (taskQueType_ == TaskQueType::QUEUE_PRIORITY)
+			return priQue_.size();
+		if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+			return groupQue_.size();
+		return taskQue_.size();
+	}
+
+	// 加锁任务队列是否已满，分组队列按各个分组自己的上限，调用方需要持有taskQueMtx_
+	bool lockedQueFull(int group) const
+	{
+		if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+		{
+			size_t maxSize = groupQue_.maxSize(group);
+			if (maxSize == 0)
+				maxSize = taskQueMaxThreshHold_;
+			return groupQue_.groupSize(group) >= maxSize;
+		}
+		return lockedQueSize() >= (size_t)taskQueMaxThreshHold_;
+	}
+
+	// 把任务放入加锁任务队列，调用方需要持有taskQueMtx_
+	void lockedQuePush(Task&& task, TaskPriority priority, TimePoint deadline, int group = 0)
+	{
+		if (taskQueType_ == TaskQueType::QUEUE_PRIORITY)
+		{
+			priQue_.push(std::move(task), priority, deadline);
+		}
+		else if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+		{
+			groupQue_.push(std::move(task), group);
+			groupCounters_[group]->taskSubmitted();
+		}
+		else
+		{
+			taskQue_.emplace(std::move(task));
+		}
+	}
+
+	// 把任务放入任务队列，队列满时最多等待到waitUntil，返回false表示提交失败，task保持不变
+	// 优先级和截止时间只对QUEUE_PRIORITY任务队列有效，分组只对QUEUE_GROUPED任务队列有效
+	bool enqueueTask(Task& task, TaskPriority priority, TimePoint deadline, TimePoint waitUntil, int group = 0)
+	{
+		// 工作窃取模式下，线程池内部线程提交的任务直接放入该线程的私有队列
+		if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
+		{
+			// 先增加任务数量再放入队列，其他线程取出任务后减少数量时不会减到0以下
+			unsigned depth = ++taskSize_;
+			workQueues_[curQueueIndex_]->push(std::move(task));
+			stats_.taskSubmitted(1, depth);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+			// 有线程阻塞等待时才需要获取锁进行通知
+			wakeWorkersUnlocked(1);
+			return true;
+		}
+
+		// 按NUMA节点分队列时，外部提交的任务放入提交线程所在节点的队列，队列满时走共享队列的等待和拒绝流程
+		if (!nodeQueues_.empty() && reserveTaskSize(1))
+		{
+			nodeQueues_[submitNode()]->push(std::move(task));
+			stats_.taskSubmitted(1, taskSize_);
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+			wakeWorkersUnlocked(1);
+			return true;
+		}
+
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			return enqueueRingTask(task, waitUntil);
+		}
+
+		// 获取锁
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+
+		// 线程通信  等待任务队列有空余
+		if (!notFull_.wait_until(lock, waitUntil,
+							[&]() -> bool
+							{ return !lockedQueFull(group); }))
+		{
+			return false;
+		}
+
+		// 如果有空余，把任务放在任务队列中
+		lockedQuePush(std::move(task), priority, deadline, group);
+		stats_.taskSubmitted(1, ++taskSize_);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+
+		// 新放了任务，只唤醒一个等待的线程
+		wakeWorkers(1);
+		lock.unlock();
+
+		// cached模式
+		wakeManagerIfBusy();
+		return true;
+	}
+
+	// 放入无锁队列，无锁队列中的任务达到运行中调小的阈值时也当作队列满
+	// 只看无锁队列自己的占用，taskSize_还包括窃取队列和NUMA节点队列中的任务
+	// 先增加任务数量再放入，消费者取出任务后减少数量时不会减到0以下，放入失败时撤销
+	bool ringPush(Task& task)
+	{
+		if (ringQue_->size() >= (size_t)taskQueMaxThreshHold_)
+			return false;
+		++taskSize_;
+		if (ringQue_->push(task))
+			return true;
+		taskSize_--;
+		return false;
+	}
+
+	// 把任务放入无锁队列，只有队列满需要阻塞或者需要唤醒线程时才加锁
+	bool enqueueRingTask(Task& task, TimePoint waitUntil)
+	{
+		bool ok = ringPush(task);
+		for (int i = 0; !ok && i < RING_PUSH_SPIN_COUNT; i++)
+		{
+			std::this_thread::yield();
+			ok = ringPush(task);
+		}
+
+		if (!ok)
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			// 先登记再重试，与消费者取出任务后检查等待数量的顺序相反，保证通知不会丢失
+			waitFullSize_++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			ok = notFull_.wait_until(lock, waitUntil,
+								[&]() -> bool
+								{ return ringPush(task); });
+			waitFullSize_--;
+			if (!ok)
+				return false;
+		}
+		stats_.taskSubmitted(1, taskSize_);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+
+		// 有线程阻塞等待时才需要获取锁进行通知
+		wakeWorkersUnlocked(1);
+
+		// cached模式
+		wakeManagerIfBusy();
+		return true;
+	}
+
+	// 从共享任务队列取出一个任务，加锁队列要求调用方已经持有taskQueMtx_
+	bool popTask(Task& task)
+	{
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			if (!ringQue_->pop(task))
+				return false;
+		}
+		else if (taskQueType_ == TaskQueType::QUEUE_PRIORITY)
+		{
+			if (!priQue_.pop(task))
+				return false;
+		}
+		else if (taskQueType_ == TaskQueType::QUEUE_GROUPED)
+		{
+			int group = 0;
+			if (!groupQue_.pop(task, group))
+				return false;
+			groupCounters_[group]->taskDequeued(
+				PoolStatsRecorder::elapsedNs(task.enqueueTime(), PoolStatsRecorder::Clock::now()));
+		}
+		else
+		{
+			if (taskQue_.empty())
+				return false;
+			task = std::move(taskQue_.front());
+			taskQue_.pop();
+		}
+		taskSize_--;
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+		return true;
+	}
+
+	// 无锁队列取出任务后，如果有生产者在等待队列空余则通知，调用方不能持有taskQueMtx_
+	void notifyNotFull()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waitFullSize_ > 0)
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			notFull_.notify_all();
+		}
+	}
+
+	// 把任务加入时间轮，到期后放入任务队列；线程池没有运行时返回false，task保持不变
+	bool addTimer(Task& task, TimePoint due)
+	{
+		if (!isPoolRunning_)
+			return false;
+		bool earlier = false;
+		{
+			std::lock_guard<std::mutex> lock(timerMtx_);
+			timers_.add(std::move(task), due);
+			int64_t next = timers_.nextExpiry().time_since_epoch().count();
+			earlier = next < nextTimerNs_;
+			nextTimerNs_ = next;
+		}
+		// 最早的到期时间提前了，限时等待的线程要按新的时间重新等待；没有这样的线程时唤醒一个空闲线程来等待
+		if (earlier)
+		{
+			std::lock_guard<std::mutex> lock(taskQueMtx_);
+			if (timerKeeper_)
+				wakeAllWaiters();
+			else if (waitThreadSize_ > 0)
+				notEmpty_.notify_one();
 		}
+		return true;
+	}
+
+	// 安排周期任务在due执行一次，线程池没有运行时返回false
+	template<typename Call>
+	bool armPeriodic(std::shared_ptr<PeriodicTimer<Call>> timer, TimePoint due)
+	{
+		Task task = PeriodicTask<Call>(this, std::move(timer), due);
+		return addTimer(task, due);
+	}
 
-		// 启动所有线程
-		for (int i = 0; i < threads_.size(); i++)
+	// 是否有已经到期的定时任务，没有定时任务时只读一次原子变量，不读取时钟
+	bool timerDue() const
+	{
+		int64_t next = nextTimerNs_.load(std::memory_order_relaxed);
+		return next != TimePoint::max().time_since_epoch().count()
+			&& std::chrono::steady_clock::now().time_since_epoch().count() >= next;
+	}
+
+	// 把到期的定时任务批量放入任务队列，队列满时按拒绝策略处理，调用方不能持有taskQueMtx_
+	// 工作线程每次取任务之前调用，所有线程都在忙时定时任务也能按时放入队列
+	void pollTimers()
+	{
+		if (!timerDue())
+			return;
+		std::vector<Task> expired;
 		{
-			threads_[i]->start();
-			idleThreadSize_++;
+			// 其他线程正在处理到期的定时任务
+			std::unique_lock<std::mutex> lock(timerMtx_, std::try_to_lock);
+			if (!lock.owns_lock())
+				return;
+			timers_.advance(std::chrono::steady_clock::now(), expired);
+			nextTimerNs_ = timers_.nextExpiry().time_since_epoch().count();
 		}
+		enqueueReady(expired);
 	}
 
-	ThreadPool(const ThreadPool &) = delete;
-	ThreadPool &operator=(const ThreadPool &) = delete;
+	// fd上等待的任务，调用方不能持有taskQueMtx_
+	template<typename Func, typename... Args>
+	auto submitOnReady(int fd, IoEvent event, Func&& func, Args&&... args)
+		-> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+	{
+		using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+		std::future<RType> result;
+		Task task = packTask(result, std::forward<Func>(func), std::forward<Args>(args)...);
+		if (!addWatch(fd, event, task))
+			dropTask(task);
+		return result;
+	}
+
+	// 等待fd就绪，失败时返回false，task保持不变
+	bool addWatch(int fd, IoEvent event, Task& task)
+	{
+		if (!isPoolRunning_ || !ioPoller_.watch(fd, event, task))
+			return false;
+		// 已经有线程在epoll_wait中时它直接收到就绪事件；否则唤醒一个空闲线程进入epoll_wait，
+		// 限时等待定时任务的线程要改为在epoll_wait中等待，所以这时唤醒全部
+		if (!ioPolling_)
+		{
+			std::lock_guard<std::mutex> lock(taskQueMtx_);
+			if (ioPolling_)
+				return true;
+			if (timerKeeper_)
+				notEmpty_.notify_all();
+			else if (waitThreadSize_ > 0)
+				notEmpty_.notify_one();
+		}
+		return true;
+	}
+
+	// 所有线程都在忙、没有线程在epoll_wait时，工作线程取任务之前检查一次就绪的fd，调用方不能持有taskQueMtx_
+	void pollIo()
+	{
+		if (ioPoller_.empty() || ioPolling_)
+			return;
+		std::vector<Task> ready;
+		ioPoller_.wait(0, ready);
+		enqueueReady(ready);
+	}
+
+	// 到期的定时任务和就绪的fd任务批量放入任务队列，队列满时按拒绝策略处理，调用方不能持有taskQueMtx_
+	// 排队时间从放入任务队列开始计算
+	void enqueueReady(std::vector<Task>& ready)
+	{
+		if (ready.empty())
+			return;
+		auto now = PoolStatsRecorder::Clock::now();
+		for (Task& task : ready)
+		{
+			task.restamp(now);
+		}
+		rejectTasks(ready, enqueueBatch(ready, TimePoint::min()));
+	}
+
+	// 阻塞等待任务，调用方持有taskQueMtx_并且已经登记在waitThreadSize_中
+	// 有定时任务时由一个空闲线程限时等待到最早的到期时间，其他空闲线程不限时等待
+	// 有fd在等待就绪时这个线程改为在epoll_wait中等待，同时负责定时任务
+	void waitForTask(std::unique_lock<std::mutex>& lock)
+	{
+		int64_t next = nextTimerNs_;
+		bool io = !ioPoller_.empty();
+		if ((next == TimePoint::max().time_since_epoch().count() && !io) || timerKeeper_)
+		{
+			notEmpty_.wait(lock);
+			return;
+		}
+		timerKeeper_ = true;
+		if (io)
+			waitForIo(lock, next);
+		else
+			notEmpty_.wait_until(lock, TimePoint(TimePoint::duration(next)));
+		timerKeeper_ = false;
+		// 被新任务唤醒，这个线程要去执行任务了，换一个空闲线程等待定时任务
+		if (taskSize_ > 0 && waitThreadSize_ > 1)
+			notEmpty_.notify_one();
+	}
+
+	// 放开taskQueMtx_在epoll_wait中等待fd就绪，最多等到next（下一个定时任务需要推进的时间）
+	// 新任务和关闭线程池通过eventfd唤醒，就绪的任务和到期的定时任务放入任务队列后重新加锁
+	void waitForIo(std::unique_lock<std::mutex>& lock, int64_t next)
+	{
+		int timeoutMs = -1;
+		if (next != TimePoint::max().time_since_epoch().count())
+		{
+			// 向上取整，不会在到期之前醒来
+			auto left = std::chrono::ceil<std::chrono::milliseconds>(
+				TimePoint(TimePoint::duration(next)) - std::chrono::steady_clock::now());
+			timeoutMs = (int)std::min<int64_t>(std::max<int64_t>(left.count(), 0), INT_MAX);
+		}
+		ioPolling_ = true;
+		lock.unlock();
+		std::vector<Task> ready;
+		ioPoller_.wait(timeoutMs, ready);
+		ioPolling_ = false;
+		enqueueReady(ready);
+		pollTimers();
+		lock.lock();
+	}
+
+	// 创建count个新线程，调用方不能持有taskQueMtx_
+	// 只在加锁时登记线程，启动线程在锁外进行，不阻塞提交任务和取任务的线程
+	void addThreads(int count)
+	{
+		std::vector<Thread*> created;
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			for (int i = 0; i < count; i++)
+			{
+				// 创建新线程，工作窃取模式下使用一个空闲的私有队列
+				std::unique_ptr<Thread> ptr;
+				if (poolMode_ == PoolMode::MODE_STEALING)
+					ptr = std::make_unique<Thread>(std::bind(&ThreadPool::stealThreadFunc, this, std::placeholders::_1, newWorkQueue()));
+				else
+					ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+				created.push_back(ptr.get());
+				threads_.emplace(ptr->getId(), std::move(ptr));
+				// 修改线程数量变量
+				curThreadSize_++;
+				idleThreadSize_++;
+			}
+		}
+		// 启动线程
+		for (Thread* thread : created)
+		{
+			thread->start();
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_SPAWN, thread->getId());
+		}
+	}
+
+	// cached模式下工作线程开始执行任务时，记录排队时间和同时忙碌的线程数量，供管理线程使用
+	void recordCachedLoad(PoolStatsRecorder::Clock::time_point now, PoolStatsRecorder::Clock::time_point enqueueTime)
+	{
+		lastQueueWaitNs_.store(PoolStatsRecorder::elapsedNs(enqueueTime, now), std::memory_order_relaxed);
+		lastDequeueNs_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+		int busy = curThreadSize_ - idleThreadSize_;
+		int peak = peakBusySize_.load(std::memory_order_relaxed);
+		while (busy > peak && !peakBusySize_.compare_exchange_weak(peak, busy, std::memory_order_relaxed))
+		{}
+	}
+
+	// cached模式的管理线程
+	// 增加线程：有积压、没有空闲线程并且排队时间超过CACHED_GROW_WAIT时，每次增加当前线程数量的1/4；
+	// 排队时间取最近开始执行的任务的排队时间，和最近一次取出任务之后积压已经持续的时间中较大的一个，
+	// 这样线程全部被长任务占住、没有任务出队时也能发现积压。
+	// 回收线程：每THREAD_MAX_IDLE_TIME秒为一个周期，只回收这个周期里同时忙碌的线程数量峰值以外的线程，
+	// 短暂的空闲不会导致回收，负载来回波动时线程数量保持在峰值附近。
+	// 没有积压时管理线程不会定时醒来，只在回收周期结束或者提交任务时发现没有空闲线程时才被唤醒。
+	// 线程池停止或者切换到其他模式时退出
+	void managerFunc()
+	{
+		using Clock = PoolStatsRecorder::Clock;
+		auto backlogSince = Clock::time_point::max();	// 管理线程观察到积压开始的时间
+		auto periodStart = Clock::now();				// 当前回收周期开始的时间
+		peakBusySize_ = 0;
+		for (;;)
+		{
+			auto now = Clock::now();
+
+			// 增加线程
+			if (taskSize_ > 0)
+			{
+				if (backlogSince == Clock::time_point::max())
+					backlogSince = now;
+				Clock::time_point lastDequeue{ Clock::duration(lastDequeueNs_.load(std::memory_order_relaxed)) };
+				auto stalled = PoolStatsRecorder::elapsedNs(std::max(lastDequeue, backlogSince), now);
+				auto wait = std::max<uint64_t>(lastQueueWaitNs_.load(std::memory_order_relaxed), stalled);
+				int room = threadSizeThreshHold_ - curThreadSize_;
+				if (idleThreadSize_ == 0 && room > 0
+					&& wait >= (uint64_t)std::chrono::nanoseconds(CACHED_GROW_WAIT).count())
+				{
+					int count = std::min({ std::max(curThreadSize_ / 4, 1), room, (int)taskSize_ });
+					addThreads(count);
+					// 新线程马上会取走积压的任务，重新开始计算排队时间
+					lastQueueWaitNs_ = 0;
+					backlogSince = Clock::time_point::max();
+				}
+			}
+			else
+			{
+				backlogSince = Clock::time_point::max();
+			}
+
+			// 回收周期结束，回收峰值以外的线程
+			if (now - periodStart >= std::chrono::seconds(THREAD_MAX_IDLE_TIME))
+			{
+				int peak = std::max(peakBusySize_.exchange(curThreadSize_ - idleThreadSize_), (int)initThreadSize_);
+				if (taskSize_ == 0)
+				{
+					// 已经在等待回收的线程不再计入，resize留下的回收要求保留
+					std::unique_lock<std::mutex> lock(taskQueMtx_);
+					int surplus = curThreadSize_ - retireSize_ - peak;
+					if (surplus > 0)
+					{
+						retireSize_ += surplus;
+						wakeAllWaiters();
+					}
+				}
+				periodStart = now;
+			}
+
+			// 有积压时按间隔检查，有多出的线程时睡到回收周期结束，否则一直睡到有积压
+			std::unique_lock<std::mutex> lock(managerMtx_);
+			if (!managerRunning())
+				return;
+			if (taskSize_ > 0 && idleThreadSize_ == 0)
+			{
+				managerCond_.wait_for(lock, CACHED_CHECK_INTERVAL);
+				continue;
+			}
+			managerSleeping_ = true;
+			if (taskSize_ > 0 && idleThreadSize_ == 0)
+			{
+				managerSleeping_ = false;
+				continue;
+			}
+			auto pred = [&]() -> bool { return !managerSleeping_ || !managerRunning(); };
+			if (curThreadSize_ > (int)initThreadSize_)
+				managerCond_.wait_until(lock, periodStart + std::chrono::seconds(THREAD_MAX_IDLE_TIME), pred);
+			else
+				managerCond_.wait(lock, pred);
+			managerSleeping_ = false;
+		}
+	}
+
+	// 管理线程是否需要继续运行
+	bool managerRunning() const
+	{
+		return isPoolRunning_ && poolMode_ == PoolMode::MODE_CACHED;
+	}
+
+	// 停止管理线程，调用方需要持有configMtx_
+	void stopManager()
+	{
+		if (!manager_.joinable())
+			return;
+		{
+			std::unique_lock<std::mutex> lock(managerMtx_);
+			managerCond_.notify_all();
+		}
+		manager_.join();
+	}
+
+	// 当前线程按回收要求退出，调用方需要持有taskQueMtx_并且retireSize_大于0
+	void retireThread(int threadid)
+	{
+		retireSize_--;
+		threads_.erase(threadid);
+		stats_.retireWorker(threadid);
+		curThreadSize_--;
+		idleThreadSize_--;
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
+		// 析构时可能正在等待最后一个线程退出
+		exitCond_.notify_all();
+	}
 
-private:
 	// 定义线程函数
 	void threadFunc(int threadid)
 	{
-		auto lastTime = std::chrono::high_resolution_clock().now();
+		pinWorker(nextPlacement_++);
+		WorkerCounters* counters = stats_.addWorker(threadid);
+		auto idleSince = PoolStatsRecorder::Clock::now();
 		for (;;)
 		{
+			// 减少线程数量时，执行完任务的线程不等任务队列空就退出
+			if (retireSize_ > 0)
+			{
+				std::unique_lock<std::mutex> lock(taskQueMtx_);
+				if (retireSize_ > 0)
+				{
+					retireThread(threadid);
+					return;
+				}
+			}
+
+			// 到期的定时任务和就绪的fd任务放入任务队列
+			pollTimers();
+			pollIo();
+
 			Task task;
+			bool spun = false;	// 这次空闲已经自旋过
+			// 无锁队列先直接取任务，取不到再加锁等待
+			if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE && popTask(task))
+			{
+				idleThreadSize_--;
+				notifyNotFull();
+			}
+			else
 			{
 				// 先获取锁
 				std::unique_lock<std::mutex> lock(taskQueMtx_);
 
-				std::cout << "tid: " << std::this_thread::get_id() << "tring task..." << std::endl;
-
-				while (taskQue_.size() == 0)
+				while (!popTask(task))
 				{
 					if (!isPoolRunning_)
 					{
 						threads_.erase(threadid);
-						std::cout << "thread id: " << std::this_thread::get_id() << "exit!" 
-							<< std::endl;
+						stats_.retireWorker(threadid);
+						THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
 						exitCond_.notify_all();
 						return;	// 线程函数结束，线程结束
 					}
 
-					if (poolMode_ == PoolMode::MODE_CACHED)
+					// 有到期的定时任务，放开锁把它们放入任务队列
+					if (timerDue())
 					{
-						if (std::cv_status::timeout == notEmpty_.wait_for(lock, std::chrono::seconds(1)))
-						{
-							auto now = std::chrono::high_resolution_clock().now();
-							auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-							if (dur.count() >= THREAD_MAX_IDLE_TIME && curThreadSize_ > initThreadSize_)
-							{
-								// 回收线程
-								threads_.erase(threadid);
-								curThreadSize_--;
-								idleThreadSize_--;
-								std::cout << "thread id: " << std::this_thread::get_id() << "exit!" << std::endl;
-								return;
-							}
-						}
+						lock.unlock();
+						pollTimers();
+						lock.lock();
+						continue;
 					}
-					else
+
+					// 阻塞之前先放开锁自旋等待，WAIT_BUSY_POLL一直自旋，只在每轮自旋结束时检查回收
+					if (waitPolicy_ != WaitPolicy::WAIT_BLOCK && !spun && retireSize_ == 0)
 					{
-						// 等待notEmpty条件
-						notEmpty_.wait(lock);
+						lock.unlock();
+						bool found = spinForTask();
+						if (!found)
+							pollIo();
+						lock.lock();
+						spun = !found && waitPolicy_ == WaitPolicy::WAIT_SPIN_PARK;
+						continue;
 					}
-				}
-
-				idleThreadSize_--;
 
-				std::cout << "tid: " << std::this_thread::get_id() << "task OK..." << std::endl;
+					// 无锁队列的生产者不持有锁，登记等待后要再确认一次任务数量，保证通知不会丢失
+					waitThreadSize_++;
+					if (taskSize_ > 0)
+					{
+						waitThreadSize_--;
+						continue;
+					}
 
-				// 从任务队列中取一个任务出来
-				task = taskQue_.front();
-				taskQue_.pop();
-				taskSize_--;
+					// 管理线程或者resize要求回收多出的空闲线程
+					if (retireSize_ > 0)
+					{
+						waitThreadSize_--;
+						retireThread(threadid);
+						return;
+					}
 
-				// 如果依然有任务，通知其他线程
-				if (taskQue_.size() > 0)
-				{
-					notEmpty_.notify_all();
+					// 等待notEmpty条件
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_PARK);
+					waitForTask(lock);
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_UNPARK);
+					waitThreadSize_--;
 				}
 
+				idleThreadSize_--;
+
 				// 取出一个任务，进行通知
 				notFull_.notify_all();
 
@@ -277,13 +1978,319 @@ private:
 			// 当前线程负责执行这个任务
 			if (task != nullptr)
 			{
-				task();	// 执行function<void()>
+				runTask(task, counters, idleSince);
+			}
+			idleThreadSize_++;
+		}
+	}
+
+	// 工作窃取模式的线程函数
+	// 线程优先消费自己的私有队列，空闲时再去共享队列和其他线程的队列中获取任务
+	void stealThreadFunc(int threadid, int index)
+	{
+		pinWorker(index);
+		WorkerCounters* counters = stats_.addWorker(threadid);
+		auto idleSince = PoolStatsRecorder::Clock::now();
+		curPool_ = this;
+		curQueueIndex_ = index;
+		for (;;)
+		{
+			// 减少线程数量时，执行完任务的线程退出，私有队列中剩下的任务由其他线程窃取
+			if (retireSize_ > 0)
+			{
+				std::unique_lock<std::mutex> lock(taskQueMtx_);
+				if (retireSize_ > 0)
+				{
+					freeQueues_.push_back(index);
+					retireThread(threadid);
+					return;
+				}
+			}
+
+			// 到期的定时任务和就绪的fd任务放入任务队列
+			pollTimers();
+			pollIo();
+
+			Task task;
+			if (!getStealTask(index, task))
+			{
+				// 阻塞之前先自旋等待，发现任务就回去重新获取
+				if (waitPolicy_ != WaitPolicy::WAIT_BLOCK && spinForTask())
+					continue;
+
+				std::unique_lock<std::mutex> lock(taskQueMtx_);
+				if (taskSize_ == 0 && !isPoolRunning_)
+				{
+					threads_.erase(threadid);
+					stats_.retireWorker(threadid);
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
+					exitCond_.notify_all();
+					return; // 线程函数结束，线程结束
+				}
+
+				if (waitPolicy_ == WaitPolicy::WAIT_BUSY_POLL && isPoolRunning_)
+					continue;
+
+				// 先登记等待线程数量再检查任务数量，与提交任务一方的顺序相反，保证通知不会丢失
+				// 被唤醒或者等到定时任务到期后回到循环开头重新获取
+				waitThreadSize_++;
+				if (taskSize_ == 0 && isPoolRunning_ && retireSize_ == 0 && !timerDue())
+				{
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_PARK);
+					waitForTask(lock);
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_UNPARK);
+				}
+				waitThreadSize_--;
+				continue;
 			}
+
+			idleThreadSize_--;
+			runTask(task, counters, idleSince);
 			idleThreadSize_++;
-			lastTime = std::chrono::high_resolution_clock().now();
 		}
 	}
 
+	// 不持有锁自旋等待任务，发现任务返回true，自旋轮数用完或者线程池退出返回false
+	// 自旋期间计入spinThreadSize_，提交任务的一方因此少唤醒阻塞的线程；
+	// 发现任务后如果剩下的任务其他自旋线程处理不过来，由这个线程唤醒一个阻塞的线程
+	bool spinForTask()
+	{
+		spinThreadSize_++;
+		SpinBackoff backoff(spinRounds_);
+		bool found = false;
+		while (isPoolRunning_)
+		{
+			if (taskSize_ > 0)
+			{
+				found = true;
+				break;
+			}
+			if (!backoff.spin())
+				break;
+		}
+		spinThreadSize_--;
+		if (found && taskSize_ > 1)
+			wakeWorkersUnlocked(1);
+		return found;
+	}
+
+	// 执行任务并记录排队时间、执行时间和执行前的空闲时间
+	void runTask(Task& task, WorkerCounters* counters, PoolStatsRecorder::Clock::time_point& idleSince)
+	{
+		if (discardCancelled(task))
+			return;
+		auto startTime = PoolStatsRecorder::Clock::now();
+		if (poolMode_ == PoolMode::MODE_CACHED)
+		{
+			recordCachedLoad(startTime, task.enqueueTime());
+			wakeManagerIfBusy();
+		}
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_START);
+		{
+			TaskArena::TaskScope scope;	// 任务结束后回收临时内存
+			task();	// 执行任务函数对象
+		}
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_END);
+		auto endTime = PoolStatsRecorder::Clock::now();
+		counters->taskDone(PoolStatsRecorder::elapsedNs(task.enqueueTime(), startTime),
+						   PoolStatsRecorder::elapsedNs(startTime, endTime),
+						   PoolStatsRecorder::elapsedNs(idleSince, startTime));
+		idleSince = endTime;
+	}
+
+	// 任务已经取消时丢弃，结果对象报告TaskCancelled
+	bool discardCancelled(Task& task)
+	{
+		if (!task.cancelled())
+			return false;
+		stats_.taskCancelled(1);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_CANCEL);
+		task.discard(std::make_exception_ptr(TaskCancelled()));
+		return true;
+	}
+
+	// 工作窃取模式下依次从私有队列、共享队列、其他线程的队列中获取任务
+	bool getStealTask(int index, Task& task)
+	{
+		// 私有队列
+		if (workQueues_[index]->pop(task))
+		{
+			taskSize_--;
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+			return true;
+		}
+
+		// 本NUMA节点的队列
+		int node = workerNodes_[index];
+		if (!nodeQueues_.empty() && stealNodeTask(node, task))
+			return true;
+
+		// 外部提交任务的共享队列
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			if (popTask(task))
+			{
+				notifyNotFull();
+				return true;
+			}
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			if (popTask(task))
+			{
+				notFull_.notify_all();
+				return true;
+			}
+		}
+
+		// 从其他线程的私有队列窃取，先窃取同一节点的线程，再跨节点窃取
+		int size = workQueueSize_.load(std::memory_order_acquire);
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int i = 1; i < size; i++)
+			{
+				int victim = (index + i) % size;
+				if ((workerNodes_[victim] == node) != (pass == 0))
+					continue;
+				if (workQueues_[victim]->steal(task))
+				{
+					taskSize_--;
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+					return true;
+				}
+			}
+		}
+
+		// 最后处理其他节点的队列
+		for (int i = 1; i < (int)nodeQueues_.size(); i++)
+		{
+			if (stealNodeTask((node + i) % nodeQueues_.size(), task))
+				return true;
+		}
+		return false;
+	}
+
+	// runPendingTask取出一个任务，线程池外部的线程在工作窃取模式下也会去窃取各个线程的私有队列
+	bool takePendingTask(Task& task)
+	{
+		if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
+			return getStealTask(curQueueIndex_, task);
+
+		if (taskQueType_ == TaskQueType::QUEUE_LOCKFREE)
+		{
+			if (popTask(task))
+			{
+				notifyNotFull();
+				return true;
+			}
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			if (popTask(task))
+			{
+				notFull_.notify_all();
+				return true;
+			}
+		}
+
+		if (poolMode_ != PoolMode::MODE_STEALING)
+			return false;
+		for (int i = 0; i < (int)nodeQueues_.size(); i++)
+		{
+			if (stealNodeTask(i, task))
+				return true;
+		}
+		int size = workQueueSize_.load(std::memory_order_acquire);
+		for (int i = 0; i < size; i++)
+		{
+			if (workQueues_[i]->steal(task))
+			{
+				taskSize_--;
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool stealNodeTask(int node, Task& task)
+	{
+		if (!nodeQueues_[node]->steal(task))
+			return false;
+		taskSize_--;
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+		return true;
+	}
+
+	// 按绑定方式计算每个线程绑定的CPU；工作窃取模式下有多个NUMA节点时创建每个节点的任务队列
+	void initPlacements()
+	{
+		if (affinityPolicy_ == AffinityPolicy::AFFINITY_NONE)
+			return;
+		if (!topology_)
+			topology_ = std::make_unique<CpuTopology>(CpuTopology::detect());
+
+		placements_ = topology_->placements(affinityPolicy_, affinityCpus_, initThreadSize_);
+		int nodes = topology_->nodeCount();
+
+		if (poolMode_ == PoolMode::MODE_STEALING && nodes > 1
+			&& taskQueType_ != TaskQueType::QUEUE_PRIORITY && taskQueType_ != TaskQueType::QUEUE_GROUPED)
+		{
+			cpuNode_ = topology_->nodeIndexTable();
+			for (int i = 0; i < nodes; i++)
+			{
+				nodeQueues_.emplace_back(std::make_unique<WorkStealingQueue<Task>>());
+			}
+		}
+	}
+
+	// 第slot个线程所在的NUMA节点下标，绑定多个CPU时取第一个CPU所在的节点
+	int placementNode(int slot) const
+	{
+		if (nodeQueues_.empty())
+			return 0;
+		const std::vector<int>& cpus = placements_[slot % placements_.size()];
+		if (cpus.empty())
+			return 0;
+		return topology_->nodeIndexOfCpu(cpus.front());
+	}
+
+	// 工作窃取模式下给新线程分配私有队列，先复用退出的线程留下的队列，返回队列下标
+	// start之外调用方需要持有taskQueMtx_；新队列放在start预留的位置上，数量在放好之后才发布给窃取的线程
+	int newWorkQueue()
+	{
+		if (!freeQueues_.empty())
+		{
+			int index = freeQueues_.back();
+			freeQueues_.pop_back();
+			return index;
+		}
+		int index = workQueues_.size();
+		workQueues_.emplace_back(std::make_unique<WorkStealingQueue<Task>>());
+		workerNodes_.push_back(placementNode(index));
+		workQueueSize_.store(index + 1, std::memory_order_release);
+		return index;
+	}
+
+	// 线程启动时绑定CPU，cached模式新增的线程按顺序循环使用已计算的绑定
+	void pinWorker(int slot)
+	{
+		if (placements_.empty())
+			return;
+		CpuTopology::pinCurrentThread(placements_[slot % placements_.size()]);
+	}
+
+	// 提交任务的线程当前所在的NUMA节点下标
+	int submitNode() const
+	{
+		int cpu = CpuTopology::currentCpu();
+		if (cpu < 0 || cpu >= (int)cpuNode_.size())
+			return 0;
+		return cpuNode_[cpu];
+	}
+
 	bool checkRunningState() const
 	{
 		return isPoolRunning_;
@@ -292,24 +2299,113 @@ private:
 private:
 	// std::vector<std::unique_ptr<Thread>> threads_;
 	std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程列表
-	size_t initThreadSize_;									   // 初始的线程数量
+	std::atomic_int initThreadSize_;						   // 核心线程数量，初始为start的参数，resize可以修改
 	std::atomic_int curThreadSize_;							   // 当前线程池线程数量
-	int threadSizeThreshHold_;								   // 线程数量上限阈值
+	std::atomic_int threadSizeThreshHold_;					   // 线程数量上限阈值
 	std::atomic_int idleThreadSize_;						   // 空闲线程数量
 
-	// Task任务 =》 函数对象
-	using Task = std::function<void()>;
 	std::queue<Task> taskQue_; 					// 任务队列
+	PriorityTaskQueue<Task> priQue_;			// 按优先级和截止时间出队的任务队列
+	GroupTaskQueue<Task> groupQue_;				// 按分组权重轮转出队的任务队列
+	std::vector<std::unique_ptr<GroupCounters>> groupCounters_;	// 每个分组的统计，和groupQue_的分组一一对应
+	std::unique_ptr<RingQueue<Task>> ringQue_;	// 无锁任务队列
+	TaskQueType taskQueType_;					// 任务队列的实现方式
+	std::atomic_int waitFullSize_;				// 阻塞等待队列空余的生产者数量
 	std::atomic_uint taskSize_;					// 任务的数量
-	int taskQueMaxThreshHold_;					// 任务队列的阈值
+	std::atomic_int taskQueMaxThreshHold_;		// 任务队列的阈值，运行中可以修改
 
 	std::mutex taskQueMtx_;			   // 保证任务队列线程安全
 	std::condition_variable notFull_;  // 表示任务队列不满
 	std::condition_variable notEmpty_; // 表示任务队列不空
 	std::condition_variable exitCond_; // 等待线程资源全部回收
 
-	PoolMode poolMode_;				 // 当前线程池工作模式
+	// 工作窃取模式下每个线程私有的任务队列，taskQue_作为外部提交任务的共享队列
+	std::vector<std::unique_ptr<WorkStealingQueue<Task>>> workQueues_;
+	std::vector<int> workerNodes_;	// 每个私有队列所属线程的NUMA节点下标
+	std::atomic_int workQueueSize_;	// 已经创建的私有队列数量，窃取的线程只访问这些队列
+	std::vector<int> freeQueues_;	// 退出的线程留下的私有队列下标，由taskQueMtx_保护
+
+	// 绑定CPU
+	AffinityPolicy affinityPolicy_;
+	std::vector<int> affinityCpus_;				// AFFINITY_LIST使用的CPU列表
+	std::unique_ptr<CpuTopology> topology_;		// 不设置时在start中自动检测
+	std::vector<std::vector<int>> placements_;	// 每个线程绑定的CPU集合
+	std::atomic_int nextPlacement_;				// 普通模式下一个启动的线程使用的绑定
+	// 工作窃取模式下每个NUMA节点一个队列，外部提交的任务放入提交线程所在节点的队列
+	std::vector<std::unique_ptr<WorkStealingQueue<Task>>> nodeQueues_;
+	std::vector<int> cpuNode_;					// 逻辑CPU编号到NUMA节点下标
+	std::atomic_int waitThreadSize_; // 阻塞等待任务的线程数量
+	WaitPolicy waitPolicy_;			 // 空闲时的等待方式
+	int spinRounds_;				 // 阻塞前自旋的轮数
+	std::atomic_int spinThreadSize_; // 正在自旋等待任务的线程数量
+	RejectPolicy rejectPolicy_;				// 任务队列满、等待超时后的拒绝策略
+	std::chrono::nanoseconds submitTimeout_; // submitTask在任务队列满时最长的等待时间
+
+	std::shared_ptr<StatePool> statePool_;	// 任务结果共享状态的内存池
+
+	// 延迟任务和周期任务
+	std::mutex timerMtx_;					// 保护timers_，不和taskQueMtx_同时持有
+	TimerWheel<Task> timers_;				// 还没到期的定时任务
+	std::atomic<int64_t> nextTimerNs_;		// timers_最早需要推进的时间，没有定时任务时为TimePoint::max()
+	bool timerKeeper_;						// 有空闲线程在限时等待定时任务到期或者在epoll_wait中，由taskQueMtx_保护
+
+	// 等待fd就绪的任务
+	IoPoller<Task> ioPoller_;				// 还没就绪的fd任务，由一个空闲线程在epoll_wait中等待
+	std::atomic_bool ioPolling_;			// 有线程在epoll_wait中，在taskQueMtx_中设置为true
+
+	PoolStatsRecorder stats_; // 运行统计
+
+	// cached模式的管理线程
+	std::thread manager_;
+	std::mutex managerMtx_;
+	std::condition_variable managerCond_;
+	std::atomic_bool managerSleeping_;		// 管理线程在等待唤醒
+	std::atomic_int retireSize_;			// 需要回收的线程数量，在taskQueMtx_保护下修改
+	std::atomic_int peakBusySize_;			// 当前回收周期内同时忙碌的线程数量峰值
+	std::atomic<uint64_t> lastQueueWaitNs_;	// 最近开始执行的任务的排队时间
+	std::atomic<int64_t> lastDequeueNs_;	// 最近开始执行任务的时间
+
+	inline static thread_local ThreadPool* curPool_ = nullptr; // 当前线程所属的线程池
+	inline static thread_local int curQueueIndex_ = -1;		   // 当前线程私有队列的下标
+
+	std::atomic<PoolMode> poolMode_; // 当前线程池工作模式，运行中可以在fixed和cached之间切换
+	std::mutex configMtx_;			 // 串行化运行中的setMode和resize
 	std::atomic_bool isPoolRunning_; // 线程池运行状态
 };
 
+template<typename Call>
+void PeriodicTask<Call>::operator()()
+{
+	{
+		CancellationToken::Scope scope(timer_->token_);
+		try
+		{
+			timer_->call_();
+		}
+		catch (...)
+		{
+		}
+	}
+	rearm();
+}
+
+template<typename Call>
+void PeriodicTask<Call>::discard(std::exception_ptr)
+{
+	// 取消或者线程池析构时rearm不会再安排
+	rearm();
+}
+
+template<typename Call>
+void PeriodicTask<Call>::rearm()
+{
+	if (timer_->token_.isCancelled())
+		return;
+	auto now = std::chrono::steady_clock::now();
+	auto next = due_ + timer_->period_;
+	if (next <= now)
+		next += timer_->period_ * ((now - next) / timer_->period_ + 1);
+	pool_->armPeriodic(std::move(timer_), next);
+}
+
 #endif // !THREADPOOL_H
@@ -0,0 +1,230 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+/*
+分层时间轮，线程池的延迟任务和周期任务使用
+时间按TIMER_TICK划分成刻度，第0层每个槽是一个刻度，第1层每个槽是第0层转一圈的时间，依次类推。
+添加定时器只是按到期时间放进某一层的某个槽；时间推进到上一层某个槽的起点时，
+把这个槽里的定时器重新分散到下面的层，最后在第0层对应的槽里到期。
+添加和到期都是常数时间，和定时器的数量无关，几十万个定时器同时等待也只占用这些槽的内存
+*/
+
+// 时间轮的精度，到期时间按这个粒度向上取整
+const auto TIMER_TICK = std::chrono::milliseconds(1);
+// 每层槽数量的位数，每层256个槽
+const int TIMER_WHEEL_BITS = 8;
+// 层数，4层可以表示2^32个刻度（约49天），更远的定时器先放在最高层，转到时重新计算位置
+const int TIMER_WHEEL_LEVELS = 4;
+
+/// <summary>
+/// 分层时间轮，需要外部加锁
+/// </summary>
+template<typename T>
+class TimerWheel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	TimerWheel()
+		: origin_(Clock::now()), current_(0), size_(0), next_(Clock::time_point::max())
+	{
+		for (auto &size : levelSize_)
+			size = 0;
+	}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	// 添加定时器，due已经过去时在下一次advance时到期
+	void add(T item, Clock::time_point due)
+	{
+		uint64_t tick = dueTick(due);
+		place(Entry{ tick, std::move(item) });
+		size_++;
+		next_ = std::min(next_, tickTime(std::max(tick, current_)));
+	}
+
+	// 推进到now，到期的定时器按到期时间的顺序移到expired的末尾
+	void advance(Clock::time_point now, std::vector<T>& expired)
+	{
+		uint64_t nowTick = now <= origin_ ? 0 : (uint64_t)((now - origin_) / TIMER_TICK);
+		while (current_ <= nowTick)
+		{
+			if (size_ == 0)
+			{
+				current_ = nowTick + 1;
+				break;
+			}
+			size_t index = current_ & SLOT_MASK;
+			// 第0层转完一圈，把上面几层对应的槽分散下来
+			if (index == 0)
+				cascade(1);
+
+			std::vector<Entry>& slot = slots_[0][index];
+			if (!slot.empty())
+			{
+				for (auto &entry : slot)
+				{
+					expired.emplace_back(std::move(entry.item_));
+				}
+				size_ -= slot.size();
+				levelSize_[0] -= slot.size();
+				slot.clear();
+			}
+
+			// 第0层没有定时器时直接跳到这一圈的末尾
+			if (levelSize_[0] == 0)
+				current_ = std::min(nowTick + 1, (current_ | SLOT_MASK) + 1);
+			else
+				current_++;
+		}
+		next_ = findNext();
+	}
+
+	// 取出所有还没到期的定时器
+	void clear(std::vector<T>& items)
+	{
+		for (auto &level : slots_)
+		{
+			for (auto &slot : level)
+			{
+				for (auto &entry : slot)
+				{
+					items.emplace_back(std::move(entry.item_));
+				}
+				slot.clear();
+			}
+		}
+		for (auto &size : levelSize_)
+			size = 0;
+		size_ = 0;
+		next_ = Clock::time_point::max();
+	}
+
+	// 最早需要advance的时间，没有定时器时返回time_point::max()
+	// 可能早于最早的到期时间（上层的槽需要分散下来的时间），不会晚于它
+	Clock::time_point nextExpiry() const
+	{
+		return next_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t tick_;	// 到期的刻度
+		T item_;
+	};
+
+	static constexpr size_t SLOT_COUNT = (size_t)1 << TIMER_WHEEL_BITS;
+	static constexpr uint64_t SLOT_MASK = SLOT_COUNT - 1;
+
+	// 到期时间向上取整到刻度，不会提前到期
+	uint64_t dueTick(Clock::time_point due) const
+	{
+		if (due <= origin_)
+			return 0;
+		auto ticks = (due - origin_ + TIMER_TICK - Clock::duration(1)) / TIMER_TICK;
+		return (uint64_t)ticks;
+	}
+
+	Clock::time_point tickTime(uint64_t tick) const
+	{
+		if (tick >= (uint64_t)((Clock::time_point::max() - origin_) / TIMER_TICK))
+			return Clock::time_point::max();
+		return origin_ + std::chrono::duration_cast<Clock::duration>(TIMER_TICK * tick);
+	}
+
+	// 按离当前刻度的距离选择层，距离超过最高层的范围时先放在最高层最远的槽
+	void place(Entry entry)
+	{
+		uint64_t tick = std::max(entry.tick_, current_);
+		uint64_t delta = tick - current_;
+		int level = 0;
+		while (level < TIMER_WHEEL_LEVELS - 1 && delta >> (TIMER_WHEEL_BITS * (level + 1)) != 0)
+			level++;
+		const uint64_t range = (uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+		if (delta >= range)
+			tick = current_ + range - 1;
+		size_t index = (tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+		slots_[level][index].emplace_back(std::move(entry));
+		levelSize_[level]++;
+	}
+
+	// 当前刻度是第level层一个槽的起点，把这个槽的定时器重新放到下面的层
+	void cascade(int level)
+	{
+		if (level >= TIMER_WHEEL_LEVELS)
+			return;
+		size_t index = (current_ >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+		std::vector<Entry> entries;
+		entries.swap(slots_[level][index]);
+		levelSize_[level] -= entries.size();
+		for (auto &entry : entries)
+		{
+			place(std::move(entry));
+		}
+		if (index == 0)
+			cascade(level + 1);
+	}
+
+	// 第0层取最早有定时器的刻度，上面几层取最早需要分散下来的时间，返回其中最早的一个
+	Clock::time_point findNext() const
+	{
+		if (size_ == 0)
+			return Clock::time_point::max();
+		uint64_t best = UINT64_MAX;
+		if (levelSize_[0] > 0)
+		{
+			for (uint64_t tick = current_; tick < current_ + SLOT_COUNT; tick++)
+			{
+				if (!slots_[0][tick & SLOT_MASK].empty())
+				{
+					best = tick;
+					break;
+				}
+			}
+		}
+		for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			if (levelSize_[level] == 0)
+				continue;
+			int shift = TIMER_WHEEL_BITS * level;
+			// 还没处理的第一个槽起点，current_正好是起点时这个槽还没有分散
+			uint64_t first = (current_ + ((uint64_t)1 << shift) - 1) >> shift;
+			for (uint64_t block = first; block < first + SLOT_COUNT; block++)
+			{
+				if (!slots_[level][block & SLOT_MASK].empty())
+				{
+					best = std::min(best, block << shift);
+					break;
+				}
+			}
+		}
+		return tickTime(best);
+	}
+
+	Clock::time_point origin_;	// 第0个刻度的时间
+	uint64_t current_;			// 下一个要处理的刻度，之前的刻度都已经处理
+	size_t size_;
+	Clock::time_point next_;	// nextExpiry的缓存
+	std::vector<Entry> slots_[TIMER_WHEEL_LEVELS][SLOT_COUNT];
+	size_t levelSize_[TIMER_WHEEL_LEVELS];	// 每层的定时器数量，整层为空时跳过
+};
+
+#endif // !TIMERWHEEL_H
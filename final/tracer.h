@@ -0,0 +1,214 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+线程池事件追踪
+编译时定义 THREADPOOL_TRACE 才会记录事件，否则 THREADPOOL_TRACE_EVENT 展开为空，没有任何开销。
+每个线程第一次记录事件时分配一个自己的环形缓冲区，之后记录事件只写自己的缓冲区，不加锁；
+缓冲区写满后覆盖最早的事件。dumpChromeTrace 把所有线程的事件导出为 Chrome trace / Perfetto
+可以打开的 JSON，最好在线程池空闲时导出
+*/
+
+/// <summary>
+/// 追踪事件类型
+/// </summary>
+enum class TraceEvent : uint8_t
+{
+	TRACE_ENQUEUE,	// 任务放入队列，arg为放入的任务数量
+	TRACE_DEQUEUE,	// 线程取出任务
+	TRACE_START,	// 开始执行任务
+	TRACE_END,		// 任务执行结束
+	TRACE_PARK,		// 线程阻塞等待任务
+	TRACE_UNPARK,	// 线程被唤醒
+	TRACE_SPAWN,	// 创建线程，arg为线程id
+	TRACE_RETIRE,	// 线程退出，arg为线程id
+	TRACE_REJECT,	// 任务队列满，提交失败
+	TRACE_CANCEL,	// 任务已经取消，取出后没有执行
+};
+
+// 每个线程缓冲区保存的事件数量，必须是2的幂
+const size_t TRACE_BUFFER_SIZE = 1 << 16;
+
+/// <summary>
+/// 事件追踪器，全局唯一
+/// </summary>
+class Tracer
+{
+public:
+	static Tracer& instance()
+	{
+		static Tracer tracer;
+		return tracer;
+	}
+
+	Tracer(const Tracer&) = delete;
+	Tracer& operator=(const Tracer&) = delete;
+
+	// 运行时开关，默认打开
+	void setEnabled(bool enabled)
+	{
+		enabled_.store(enabled, std::memory_order_relaxed);
+	}
+
+	// 记录当前线程的一个事件
+	void record(TraceEvent event, uint64_t arg = 0)
+	{
+		if (!enabled_.load(std::memory_order_relaxed))
+			return;
+		Buffer* buffer = localBuffer();
+		uint64_t head = buffer->head_.load(std::memory_order_relaxed);
+		Record& rec = buffer->records_[head & (TRACE_BUFFER_SIZE - 1)];
+		rec.time_ = now();
+		rec.arg_ = arg;
+		rec.event_ = event;
+		buffer->head_.store(head + 1, std::memory_order_release);
+	}
+
+	// 清空所有线程已经记录的事件
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		for (auto &buffer : buffers_)
+		{
+			buffer->tail_ = buffer->head_.load(std::memory_order_acquire);
+		}
+	}
+
+	// 导出为Chrome trace格式的JSON
+	void dumpChromeTrace(std::ostream& os)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		os << "{\"traceEvents\":[";
+		bool first = true;
+		for (auto &buffer : buffers_)
+		{
+			if (!first)
+				os << ",";
+			first = false;
+			os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid_
+			   << ",\"args\":{\"name\":\"thread " << buffer->tid_ << "\"}}";
+
+			uint64_t head = buffer->head_.load(std::memory_order_acquire);
+			uint64_t begin = buffer->tail_;
+			if (head - begin > TRACE_BUFFER_SIZE)
+				begin = head - TRACE_BUFFER_SIZE;
+			for (uint64_t i = begin; i < head; i++)
+			{
+				const Record& rec = buffer->records_[i & (TRACE_BUFFER_SIZE - 1)];
+				os << ",{\"name\":\"" << eventName(rec.event_) << "\",\"ph\":\"" << eventPhase(rec.event_)
+				   << "\",\"ts\":" << rec.time_ / 1000 << "." << rec.time_ % 1000 / 100
+				   << ",\"pid\":1,\"tid\":" << buffer->tid_;
+				if (eventPhase(rec.event_)[0] == 'i')
+					os << ",\"s\":\"t\"";
+				os << ",\"args\":{\"arg\":" << rec.arg_ << "}}";
+			}
+		}
+		os << "]}" << std::endl;
+	}
+
+	bool dumpChromeTrace(const std::string& path)
+	{
+		std::ofstream ofs(path);
+		if (!ofs)
+			return false;
+		dumpChromeTrace(ofs);
+		return true;
+	}
+
+private:
+	Tracer() : enabled_(true), nextTid_(0)
+	{}
+
+	struct Record
+	{
+		uint64_t time_;	// 纳秒时间戳
+		uint64_t arg_;
+		TraceEvent event_;
+	};
+
+	// 每个线程一个，只有所属线程写入
+	struct Buffer
+	{
+		explicit Buffer(int tid)
+			: records_(new Record[TRACE_BUFFER_SIZE]), head_(0), tail_(0), tid_(tid)
+		{}
+		std::unique_ptr<Record[]> records_;
+		std::atomic<uint64_t> head_;	// 下一个写入位置
+		uint64_t tail_;					// clear之后的起始位置，由mtx_保护
+		int tid_;						// 导出时使用的线程编号
+	};
+
+	// 线程第一次记录事件时注册缓冲区，缓冲区由追踪器持有，线程退出后事件依然可以导出
+	Buffer* localBuffer()
+	{
+		thread_local Buffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			buffers_.emplace_back(std::make_unique<Buffer>(nextTid_++));
+			buffer = buffers_.back().get();
+		}
+		return buffer;
+	}
+
+	static uint64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static const char* eventName(TraceEvent event)
+	{
+		switch (event)
+		{
+		case TraceEvent::TRACE_ENQUEUE: return "enqueue";
+		case TraceEvent::TRACE_DEQUEUE: return "dequeue";
+		case TraceEvent::TRACE_START:
+		case TraceEvent::TRACE_END: return "task";
+		case TraceEvent::TRACE_PARK:
+		case TraceEvent::TRACE_UNPARK: return "park";
+		case TraceEvent::TRACE_SPAWN: return "spawn";
+		case TraceEvent::TRACE_RETIRE: return "retire";
+		case TraceEvent::TRACE_REJECT: return "reject";
+		case TraceEvent::TRACE_CANCEL: return "cancel";
+		}
+		return "unknown";
+	}
+
+	// 执行任务和阻塞等待记录为时间段，其他事件记录为时间点
+	static const char* eventPhase(TraceEvent event)
+	{
+		switch (event)
+		{
+		case TraceEvent::TRACE_START:
+		case TraceEvent::TRACE_PARK: return "B";
+		case TraceEvent::TRACE_END:
+		case TraceEvent::TRACE_UNPARK: return "E";
+		default: return "i";
+		}
+	}
+
+private:
+	std::atomic_bool enabled_;
+	std::mutex mtx_;	// 保护buffers_
+	std::vector<std::unique_ptr<Buffer>> buffers_;
+	int nextTid_;
+};
+
+#ifdef THREADPOOL_TRACE
+#define THREADPOOL_TRACE_EVENT(...) Tracer::instance().record(__VA_ARGS__)
+#else
+#define THREADPOOL_TRACE_EVENT(...) ((void)0)
+#endif
+
+#endif // !TRACER_H
@@ -0,0 +1,77 @@
+#ifndef WAITPOLICY_H
+#define WAITPOLICY_H
+
+#include <thread>
+#include <algorithm>
+
+/*
+工作线程没有任务时的等待方式
+阻塞等待要经过一次futex睡眠和唤醒，耗时可能比微秒级的任务本身还长；
+先自旋一段时间再阻塞，任务间隔很短时线程不会睡眠，提交任务的一方也不需要唤醒它。
+自旋中的线程不计入阻塞等待的线程数量，提交任务时只唤醒自旋线程处理不过来的那部分任务
+*/
+
+/// <summary>
+/// 工作线程空闲时的等待方式
+/// </summary>
+enum class WaitPolicy
+{
+	WAIT_BLOCK,		// 直接阻塞等待，不占用CPU
+	WAIT_SPIN_PARK,	// 先自旋（pause指令退避，之后让出CPU），自旋次数用完再阻塞
+	WAIT_BUSY_POLL,	// 一直自旋不阻塞，延迟最低，空闲时也占满CPU，适合独占CPU的部署
+};
+
+// 默认的自旋轮数
+const int WAIT_SPIN_ROUNDS = 40;
+// 前这么多轮执行pause指令，每轮次数翻倍，之后每轮让出一次CPU
+const int WAIT_PAUSE_ROUNDS = 10;
+// 每轮pause指令次数的上限
+const int WAIT_MAX_PAUSES = 64;
+
+/// <summary>
+/// 有上限的指数退避自旋
+/// </summary>
+class SpinBackoff
+{
+public:
+	explicit SpinBackoff(int rounds)
+		: rounds_(rounds), round_(0)
+	{}
+
+	// 自旋一轮，轮数用完返回false
+	bool spin()
+	{
+		if (round_ >= rounds_)
+			return false;
+		if (round_ < WAIT_PAUSE_ROUNDS)
+		{
+			int pauses = std::min(1 << round_, WAIT_MAX_PAUSES);
+			for (int i = 0; i < pauses; i++)
+				cpuRelax();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+		round_++;
+		return true;
+	}
+
+	// 告诉CPU当前在自旋等待，降低功耗并让出超线程的执行资源
+	static void cpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+private:
+	int rounds_;
+	int round_;
+};
+
+#endif // !WAITPOLICY_H
@@ -2,19 +2,31 @@
 
 #include <iostream>
 #include <thread>
+#include <algorithm>
 
 /// <summary>
 /// 线程池方法实现
 /// </summary>
 const int TASK_MAX_THRESHHOLD = INT32_MAX;
 const int THREAD_MAX_THRESHHOLD = 10;
-const int THREAD_MAX_IDLE_TIME = 10;
+const int THREAD_MAX_IDLE_TIME = 10;	// cached模式下多出的线程连续空闲这么多秒才回收
+const auto CACHED_GROW_WAIT = std::chrono::milliseconds(1);	// 任务排队超过这个时间才增加线程
+const auto CACHED_CHECK_INTERVAL = std::chrono::milliseconds(1);	// 有积压时管理线程检查的间隔
 
 // 构造
 ThreadPool::ThreadPool()
-	: initThreadSize_(0), taskSize_(0), idleThreadSize_(0),
-	  curThreadSize_(0), taskQueMaxThreshHold_(TASK_MAX_THRESHHOLD),
-	  threadSizeThreshHold_(THREAD_MAX_THRESHHOLD),
+	: initThreadSize_(0), curThreadSize_(0),
+	  threadSizeThreshHold_(THREAD_MAX_THRESHHOLD), idleThreadSize_(0),
+	  taskSize_(0), taskQueMaxThreshHold_(TASK_MAX_THRESHHOLD),
+	  workQueueSize_(0),
+	  affinityPolicy_(AffinityPolicy::AFFINITY_NONE), nextPlacement_(0),
+	  waitThreadSize_(0), waitPolicy_(WaitPolicy::WAIT_BLOCK), spinRounds_(WAIT_SPIN_ROUNDS), spinThreadSize_(0),
+	  rejectPolicy_(RejectPolicy::REJECT_FAIL), submitTimeout_(SUBMIT_TIMEOUT),
+	  statePool_(std::make_shared<StatePool>()),
+	  nextTimerNs_(TimePoint::max().time_since_epoch().count()), timerKeeper_(false),
+	  ioPolling_(false),
+	  managerSleeping_(false), retireSize_(0),
+	  peakBusySize_(0), lastQueueWaitNs_(0), lastDequeueNs_(0),
 	  poolMode_(PoolMode::MODE_FIXED), isPoolRunning_(false)
 {
 }
@@ -24,79 +36,762 @@ ThreadPool::~ThreadPool()
 {
 	isPoolRunning_ = false;
 
+	// 先停止管理线程，之后不会再创建新线程
+	if (manager_.joinable())
+	{
+		{
+			std::unique_lock<std::mutex> lock(managerMtx_);
+			managerCond_.notify_all();
+		}
+		manager_.join();
+	}
+
 	// 等待线程池里所有线程返回
 	std::unique_lock<std::mutex> lock(taskQueMtx_);
-	notEmpty_.notify_all();
+	wakeAllWaiters();
 	exitCond_.wait(lock, [&]() -> bool
 				   { return threads_.size() == 0; });
+	lock.unlock();
+
+	// 还没到期的定时任务不再执行
+	std::vector<std::shared_ptr<TaskBase>> pending;
+	{
+		std::lock_guard<std::mutex> timerLock(timerMtx_);
+		timers_.clear(pending);
+	}
+	// 还在等待fd就绪的任务也不再执行
+	ioPoller_.clear(pending);
+	for (auto &task : pending)
+	{
+		task->discard(std::make_exception_ptr(TaskCancelled()));
+	}
 }
 
 // 设置线程池工作模式
+// 运行中切到cached时启动管理线程，切回fixed时停止管理线程，回收多于核心线程数量的线程
 void ThreadPool::setMode(PoolMode mode)
 {
-	if (checkRunningState())
+	std::lock_guard<std::mutex> config(configMtx_);
+	if (!checkRunningState())
+	{
+		poolMode_ = mode;
+		return;
+	}
+	// 工作窃取模式的私有队列在start时创建
+	if (poolMode_ == mode || poolMode_ == PoolMode::MODE_STEALING || mode == PoolMode::MODE_STEALING)
 		return;
+
 	poolMode_ = mode;
+	if (mode == PoolMode::MODE_CACHED)
+	{
+		manager_ = std::thread(&ThreadPool::managerFunc, this);
+		return;
+	}
+	stopManager();
+	std::unique_lock<std::mutex> lock(taskQueMtx_);
+	retireSize_ = std::max(curThreadSize_ - (int)initThreadSize_, 0);
+	if (retireSize_ > 0)
+		wakeAllWaiters();
 }
 
-// 设置任务队列上限阈值
+// 设置任务队列上限阈值	已经排队的任务不受影响
 void ThreadPool::setTaskQueMaxThreshHold(int threshhold)
 {
-	if (checkRunningState())
-		return;
 	taskQueMaxThreshHold_ = threshhold;
+	if (!checkRunningState())
+		return;
+	// 阈值调大后唤醒等待队列空余的生产者
+	std::unique_lock<std::mutex> lock(taskQueMtx_);
+	notFull_.notify_all();
 }
 
 // 设置线程池cached模式下线程阈值
 void ThreadPool::setThreadSizeThreshHold(int threshhold)
 {
-	if (checkRunningState())
-		return;
-	if (poolMode_ == PoolMode::MODE_CACHED)
+	if (poolMode_ == PoolMode::MODE_CACHED || (poolMode_ == PoolMode::MODE_STEALING && !checkRunningState()))
 	{
 		threadSizeThreshHold_ = threshhold;
 	}
 }
 
+// 设置工作线程空闲时的等待方式	WAIT_BUSY_POLL时spinRounds为检查回收和退出的间隔
+void ThreadPool::setWaitPolicy(WaitPolicy policy, int spinRounds)
+{
+	if (checkRunningState())
+		return;
+	waitPolicy_ = policy;
+	spinRounds_ = spinRounds;
+}
+
+// 设置任务队列满、等待超时后的拒绝策略
+void ThreadPool::setRejectPolicy(RejectPolicy policy)
+{
+	if (checkRunningState())
+		return;
+	rejectPolicy_ = policy;
+}
+
+// 设置submitTask和submitBatch在任务队列满时最长的等待时间
+void ThreadPool::setSubmitTimeout(std::chrono::nanoseconds timeout)
+{
+	if (checkRunningState())
+		return;
+	submitTimeout_ = timeout;
+}
+
+// 设置工作线程绑定CPU的方式
+void ThreadPool::setAffinity(AffinityPolicy policy, std::vector<int> cpus)
+{
+	if (checkRunningState())
+		return;
+	affinityPolicy_ = policy;
+	affinityCpus_ = std::move(cpus);
+}
+
+// 使用给定的CPU拓扑代替自动检测
+void ThreadPool::setCpuTopology(CpuTopology topology)
+{
+	if (checkRunningState())
+		return;
+	topology_ = std::make_unique<CpuTopology>(std::move(topology));
+}
+
 // 给线程池提交任务	用户调用该接口，传入任务对象，生产任务
 Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
 {
+	return submitFor(std::move(sp), submitTimeout_);
+}
+
+// 给线程池提交任务	任务队列满时最多等待timeout，之后按拒绝策略处理
+Result ThreadPool::submitFor(std::shared_ptr<Task> sp, std::chrono::nanoseconds timeout)
+{
+	// 先创建结果对象，任务入队后可能马上被执行
+	auto state = newResultState<Any>();
+	Result result(sp, state);
+	if (!enqueueTask(sp, waitDeadline(timeout)) && !rejectTask(sp))
+	{
+		Result rejected(sp, std::move(state), false);
+		failTask(*sp);
+		return rejected;
+	}
+	return result;
+}
+
+// 提交不需要结果的任务	不创建结果对象
+bool ThreadPool::post(std::shared_ptr<TaskBase> sp)
+{
+	if (enqueueTask(sp, waitDeadline(submitTimeout_)) || rejectTask(sp))
+		return true;
+	failTask(*sp);
+	return false;
+}
+
+// 尝试提交任务	从不阻塞，任务队列满时直接返回提交失败的结果
+Result ThreadPool::trySubmit(std::shared_ptr<Task> sp)
+{
+	auto state = newResultState<Any>();
+	Result result(sp, state);
+	if (!enqueueTask(sp, TimePoint::min()))
+	{
+		Result rejected(sp, std::move(state), false);
+		failTask(*sp);
+		return rejected;
+	}
+	return result;
+}
+
+// 延迟执行任务	到期后和普通任务一样放入任务队列
+Result ThreadPool::scheduleAfter(std::chrono::nanoseconds delay, std::shared_ptr<Task> sp)
+{
+	auto state = newResultState<Any>();
+	Result result(sp, state);
+	if (!addTimer(sp, waitDeadline(delay)))
+	{
+		Result rejected(sp, std::move(state), false);
+		failTask(*sp);
+		return rejected;
+	}
+	return result;
+}
+
+// fd可读时执行任务
+Result ThreadPool::submitOnReadable(int fd, std::shared_ptr<Task> sp)
+{
+	return submitOnReady(fd, IoEvent::IO_READABLE, std::move(sp));
+}
+
+// fd可写时执行任务
+Result ThreadPool::submitOnWritable(int fd, std::shared_ptr<Task> sp)
+{
+	return submitOnReady(fd, IoEvent::IO_WRITABLE, std::move(sp));
+}
+
+// 取消fd上还在等待的任务	报告TaskCancelled
+size_t ThreadPool::cancelIo(int fd)
+{
+	std::vector<std::shared_ptr<TaskBase>> cancelled;
+	ioPoller_.cancel(fd, cancelled);
+	for (auto &task : cancelled)
+	{
+		task->discard(std::make_exception_ptr(TaskCancelled()));
+	}
+	return cancelled.size();
+}
+
+// fd上等待的任务	和scheduleAfter一样先创建结果对象
+Result ThreadPool::submitOnReady(int fd, IoEvent event, std::shared_ptr<Task> sp)
+{
+	auto state = newResultState<Any>();
+	Result result(sp, state);
+	if (!addWatch(fd, event, sp))
+	{
+		Result rejected(sp, std::move(state), false);
+		failTask(*sp);
+		return rejected;
+	}
+	return result;
+}
+
+// 等待timeout对应的时间点	timeout过长时一直等待
+ThreadPool::TimePoint ThreadPool::waitDeadline(std::chrono::nanoseconds timeout)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (timeout >= TimePoint::max() - now)
+		return TimePoint::max();
+	return now + timeout;
+}
+
+// 按拒绝策略处理没能放入任务队列的任务	返回false表示任务提交失败
+bool ThreadPool::rejectTask(std::shared_ptr<TaskBase> sp)
+{
+	if (rejectPolicy_ == RejectPolicy::REJECT_CALLER_RUNS)
+	{
+		// 由提交任务的线程执行
+		stats_.taskRejected(1);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+		if (!discardCancelled(*sp))
+			sp->exec();
+		return true;
+	}
+	if (rejectPolicy_ == RejectPolicy::REJECT_DROP_OLDEST)
+	{
+		return replaceOldest(sp);
+	}
+	return false;
+}
+
+// 任务提交失败或者被挤出队列	结果对象报告TaskRejected
+void ThreadPool::failTask(TaskBase& task)
+{
+	stats_.taskRejected(1);
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_REJECT, 1);
+	task.discard(std::make_exception_ptr(TaskRejected()));
+}
+
+// 任务已经取消时丢弃	结果对象报告TaskCancelled
+bool ThreadPool::discardCancelled(TaskBase& task)
+{
+	if (!task.token_.isCancelled())
+		return false;
+	stats_.taskCancelled(1);
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_CANCEL);
+	task.discard(std::make_exception_ptr(TaskCancelled()));
+	return true;
+}
+
+// 丢弃共享任务队列中最早的任务，把sp放进去	共享队列已经空了时返回false
+bool ThreadPool::replaceOldest(std::shared_ptr<TaskBase> sp)
+{
+	std::shared_ptr<TaskBase> victim;	// 在锁外丢弃
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		if (taskQue_.size() >= (size_t)taskQueMaxThreshHold_)
+		{
+			if (taskQue_.empty())
+				return false;
+			victim = std::move(taskQue_.front());
+			taskQue_.pop();
+			taskSize_--;
+		}
+		sp->enqueueTime_ = PoolStatsRecorder::Clock::now();
+		taskQue_.emplace(sp);
+		stats_.taskSubmitted(1, ++taskSize_);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+		wakeWorkers(1);
+	}
+	if (victim != nullptr)
+		failTask(*victim);
+	return true;
+}
+
+// 把任务放入任务队列	队列满时最多等待到waitUntil
+bool ThreadPool::enqueueTask(std::shared_ptr<TaskBase> sp, TimePoint waitUntil)
+{
+	// 工作窃取模式下，线程池内部线程提交的任务直接放入该线程的私有队列
+	if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
+	{
+		sp->enqueueTime_ = PoolStatsRecorder::Clock::now();
+		// 先增加任务数量再放入队列，其他线程取出任务后减少数量时不会减到0以下
+		unsigned depth = ++taskSize_;
+		workQueues_[curQueueIndex_]->push(sp);
+		stats_.taskSubmitted(1, depth);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
+		// 有线程阻塞等待时才需要获取锁进行通知
+		wakeWorkersUnlocked(1);
+		return true;
+	}
+
 	// 获取锁
 	std::unique_lock<std::mutex> lock(taskQueMtx_);
 
-	// 线程通信  等待任务队列有空余
-	// 用户提交任务，最长不能阻塞超过1s，否则判断任务提交
-	if (!notFull_.wait_for(lock, std::chrono::seconds(1),
-						   [&]() -> bool
-						   { return taskQue_.size() < (size_t)taskQueMaxThreshHold_; }))
+	// 线程通信  等待任务队列有空余，最多等待到waitUntil
+	if (!notFull_.wait_until(lock, waitUntil,
+							 [&]() -> bool
+							 { return taskQue_.size() < (size_t)taskQueMaxThreshHold_; }))
 	{
-		// 等待1s,条件依然没满足
-		std::cerr << "task queue is full, submit task fail" << std::endl;
-		return Result(sp, false);
+		return false;
 	}
 
 	// 如果有空余，把任务放在任务队列中
+	sp->enqueueTime_ = PoolStatsRecorder::Clock::now();
 	taskQue_.emplace(sp);
-	taskSize_++;
+	stats_.taskSubmitted(1, ++taskSize_);
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, 1);
 
-	// 新放了任务，任务队列肯定不空，notEmpty通知
-	notEmpty_.notify_all();
+	// 新放了任务，只唤醒一个等待的线程
+	wakeWorkers(1);
+	lock.unlock();
 
 	// cached模式
-	if (poolMode_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ && curThreadSize_ < threadSizeThreshHold_)
+	wakeManagerIfBusy();
+	return true;
+}
+
+// 批量把任务放入任务队列	返回成功放入的任务数量，没放入的总是排在最后
+size_t ThreadPool::enqueueBatch(std::vector<std::shared_ptr<TaskBase>>& tasks, TimePoint waitUntil)
+{
+	size_t count = tasks.size();
+	if (count == 0)
+		return 0;
+
+	// 工作窃取模式下，线程池内部线程提交的任务直接放入该线程的私有队列
+	if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
 	{
-		// 创建新线程
-		auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
-		int threadId = ptr->getId();
-		threads_.emplace(threadId, std::move(ptr));
-		// 启动线程
-		threads_[threadId]->start();
-		// 修改线程数量变量
-		curThreadSize_++;
-		idleThreadSize_++;
+		auto now = PoolStatsRecorder::Clock::now();
+		for (auto &task : tasks)
+		{
+			task->enqueueTime_ = now;
+		}
+		unsigned depth = taskSize_ += count;
+		workQueues_[curQueueIndex_]->pushBatch(tasks);
+		stats_.taskSubmitted(count, depth);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, count);
+		wakeWorkersUnlocked(count);
+		return count;
+	}
+
+	// 获取锁
+	std::unique_lock<std::mutex> lock(taskQueMtx_);
+	size_t done = 0;
+	while (done < count)
+	{
+		// 线程通信  等待任务队列有空余，整批最多等待到waitUntil
+		if (!notFull_.wait_until(lock, waitUntil,
+								 [&]() -> bool
+								 { return taskQue_.size() < (size_t)taskQueMaxThreshHold_; }))
+		{
+			break;
+		}
+
+		// 把能放下的任务一次性放入队列
+		size_t begin = done;
+		auto now = PoolStatsRecorder::Clock::now();
+		while (done < count && taskQue_.size() < (size_t)taskQueMaxThreshHold_)
+		{
+			tasks[done]->enqueueTime_ = now;
+			taskQue_.emplace(tasks[done++]);
+			taskSize_++;
+		}
+		stats_.taskSubmitted(done - begin, taskSize_);
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_ENQUEUE, done - begin);
+		wakeWorkers(done - begin);
+	}
+
+	// cached模式
+	lock.unlock();
+	wakeManagerIfBusy();
+	return done;
+}
+
+// 唤醒所有阻塞等待任务的线程	在epoll_wait中的线程通过eventfd唤醒
+void ThreadPool::wakeAllWaiters()
+{
+	notEmpty_.notify_all();
+	if (ioPolling_)
+		ioPoller_.wake();
+}
+
+// 唤醒count个阻塞等待任务的线程	调用方需要持有taskQueMtx_
+// 自旋中的线程会自己发现新任务，只唤醒它们处理不过来的部分
+void ThreadPool::wakeWorkers(size_t count)
+{
+	size_t spinning = spinThreadSize_;
+	if (count <= spinning)
+		return;
+	count -= spinning;
+	// 在epoll_wait中的线程也计入waitThreadSize_，count小于它时条件变量上的线程就够了
+	if (count >= (size_t)waitThreadSize_)
+	{
+		wakeAllWaiters();
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			notEmpty_.notify_one();
+		}
+	}
+}
+
+// 不持有taskQueMtx_时唤醒count个线程	没有线程阻塞等待就不加锁
+void ThreadPool::wakeWorkersUnlocked(size_t count)
+{
+	if (count > (size_t)spinThreadSize_ && waitThreadSize_ > 0)
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		wakeWorkers(count);
+	}
+}
+
+// 不持有锁自旋等待任务	发现任务返回true，自旋轮数用完或者线程池退出返回false
+// 自旋期间计入spinThreadSize_，提交任务的一方因此少唤醒阻塞的线程；
+// 发现任务后如果剩下的任务其他自旋线程处理不过来，由这个线程唤醒一个阻塞的线程
+bool ThreadPool::spinForTask()
+{
+	spinThreadSize_++;
+	SpinBackoff backoff(spinRounds_);
+	bool found = false;
+	while (isPoolRunning_)
+	{
+		if (taskSize_ > 0)
+		{
+			found = true;
+			break;
+		}
+		if (!backoff.spin())
+			break;
+	}
+	spinThreadSize_--;
+	if (found && taskSize_ > 1)
+		wakeWorkersUnlocked(1);
+	return found;
+}
+
+// 把任务加入时间轮	最早的到期时间提前了，限时等待的线程要按新的时间重新等待；没有这样的线程时唤醒一个空闲线程来等待
+bool ThreadPool::addTimer(std::shared_ptr<TaskBase> sp, TimePoint due)
+{
+	if (!isPoolRunning_)
+		return false;
+	bool earlier = false;
+	{
+		std::lock_guard<std::mutex> lock(timerMtx_);
+		timers_.add(std::move(sp), due);
+		int64_t next = timers_.nextExpiry().time_since_epoch().count();
+		earlier = next < nextTimerNs_;
+		nextTimerNs_ = next;
+	}
+	if (earlier)
+	{
+		std::lock_guard<std::mutex> lock(taskQueMtx_);
+		if (timerKeeper_)
+			wakeAllWaiters();
+		else if (waitThreadSize_ > 0)
+			notEmpty_.notify_one();
+	}
+	return true;
+}
+
+// 是否有已经到期的定时任务	没有定时任务时只读一次原子变量
+bool ThreadPool::timerDue() const
+{
+	int64_t next = nextTimerNs_.load(std::memory_order_relaxed);
+	return next != TimePoint::max().time_since_epoch().count()
+		&& std::chrono::steady_clock::now().time_since_epoch().count() >= next;
+}
+
+// 把到期的定时任务批量放入任务队列	工作线程每次取任务之前调用，所有线程都在忙时定时任务也能按时放入队列
+void ThreadPool::pollTimers()
+{
+	if (!timerDue())
+		return;
+	std::vector<std::shared_ptr<TaskBase>> expired;
+	{
+		// 其他线程正在处理到期的定时任务
+		std::unique_lock<std::mutex> lock(timerMtx_, std::try_to_lock);
+		if (!lock.owns_lock())
+			return;
+		timers_.advance(std::chrono::steady_clock::now(), expired);
+		nextTimerNs_ = timers_.nextExpiry().time_since_epoch().count();
+	}
+	enqueueReady(expired);
+}
+
+// 等待fd就绪	已经有线程在epoll_wait中时它直接收到就绪事件；否则唤醒一个空闲线程进入epoll_wait，
+// 限时等待定时任务的线程要改为在epoll_wait中等待，所以这时唤醒全部
+bool ThreadPool::addWatch(int fd, IoEvent event, std::shared_ptr<TaskBase> sp)
+{
+	if (!isPoolRunning_ || !ioPoller_.watch(fd, event, sp))
+		return false;
+	if (!ioPolling_)
+	{
+		std::lock_guard<std::mutex> lock(taskQueMtx_);
+		if (ioPolling_)
+			return true;
+		if (timerKeeper_)
+			notEmpty_.notify_all();
+		else if (waitThreadSize_ > 0)
+			notEmpty_.notify_one();
+	}
+	return true;
+}
+
+// 检查一次就绪的fd	所有线程都在忙、没有线程在epoll_wait时由工作线程在取任务之前调用
+void ThreadPool::pollIo()
+{
+	if (ioPoller_.empty() || ioPolling_)
+		return;
+	std::vector<std::shared_ptr<TaskBase>> ready;
+	ioPoller_.wait(0, ready);
+	enqueueReady(ready);
+}
+
+// 批量放入任务队列	队列满时按拒绝策略处理
+void ThreadPool::enqueueReady(std::vector<std::shared_ptr<TaskBase>>& ready)
+{
+	if (ready.empty())
+		return;
+	size_t done = enqueueBatch(ready, TimePoint::min());
+	for (size_t i = done; i < ready.size(); i++)
+	{
+		if (!rejectTask(ready[i]))
+			failTask(*ready[i]);
+	}
+}
+
+// 阻塞等待任务	有等待中的fd时这个线程改为在epoll_wait中等待，同时负责定时任务；其他空闲线程不限时等待
+void ThreadPool::waitForTask(std::unique_lock<std::mutex>& lock)
+{
+	int64_t next = nextTimerNs_;
+	bool io = !ioPoller_.empty();
+	if ((next == TimePoint::max().time_since_epoch().count() && !io) || timerKeeper_)
+	{
+		notEmpty_.wait(lock);
+		return;
+	}
+	timerKeeper_ = true;
+	if (io)
+		waitForIo(lock, next);
+	else
+		notEmpty_.wait_until(lock, TimePoint(TimePoint::duration(next)));
+	timerKeeper_ = false;
+	// 被新任务唤醒，这个线程要去执行任务了，换一个空闲线程等待定时任务
+	if (taskSize_ > 0 && waitThreadSize_ > 1)
+		notEmpty_.notify_one();
+}
+
+// 在epoll_wait中等待fd就绪	新任务和关闭线程池通过eventfd唤醒，就绪的任务和到期的定时任务放入任务队列后重新加锁
+void ThreadPool::waitForIo(std::unique_lock<std::mutex>& lock, int64_t next)
+{
+	int timeoutMs = -1;
+	if (next != TimePoint::max().time_since_epoch().count())
+	{
+		// 向上取整，不会在到期之前醒来
+		auto left = std::chrono::ceil<std::chrono::milliseconds>(
+			TimePoint(TimePoint::duration(next)) - std::chrono::steady_clock::now());
+		timeoutMs = (int)std::min<int64_t>(std::max<int64_t>(left.count(), 0), INT_MAX);
+	}
+	ioPolling_ = true;
+	lock.unlock();
+	std::vector<std::shared_ptr<TaskBase>> ready;
+	ioPoller_.wait(timeoutMs, ready);
+	ioPolling_ = false;
+	enqueueReady(ready);
+	pollTimers();
+	lock.lock();
+}
+
+// cached模式下有积压并且没有空闲线程时唤醒管理线程，由管理线程根据排队时间决定是否增加线程
+// 提交任务的线程自己不创建线程，调用时也不持有任务队列的锁
+void ThreadPool::wakeManagerIfBusy()
+{
+	if (poolMode_ != PoolMode::MODE_CACHED || idleThreadSize_ > 0 || taskSize_ == 0)
+		return;
+	// 与管理线程登记睡眠后检查任务数量的顺序相反，保证唤醒不会丢失
+	if (managerSleeping_ && managerSleeping_.exchange(false))
+	{
+		std::unique_lock<std::mutex> lock(managerMtx_);
+		managerCond_.notify_one();
+	}
+}
+
+// 创建count个新线程	调用方不能持有taskQueMtx_
+// 只在加锁时登记线程，启动线程在锁外进行，不阻塞提交任务和取任务的线程
+void ThreadPool::addThreads(int count)
+{
+	std::vector<Thread*> created;
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		for (int i = 0; i < count; i++)
+		{
+			// 创建新线程，工作窃取模式下使用一个空闲的私有队列
+			std::unique_ptr<Thread> ptr;
+			if (poolMode_ == PoolMode::MODE_STEALING)
+				ptr = std::make_unique<Thread>(std::bind(&ThreadPool::stealThreadFunc, this, std::placeholders::_1, newWorkQueue()));
+			else
+				ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+			created.push_back(ptr.get());
+			threads_.emplace(ptr->getId(), std::move(ptr));
+			// 修改线程数量变量
+			curThreadSize_++;
+			idleThreadSize_++;
+		}
+	}
+	// 启动线程
+	for (Thread* thread : created)
+	{
+		thread->start();
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_SPAWN, thread->getId());
+	}
+}
+
+// 工作窃取模式下给新线程分配私有队列
+// start之外调用方需要持有taskQueMtx_；新队列放在start预留的位置上，数量在放好之后才发布给窃取的线程
+int ThreadPool::newWorkQueue()
+{
+	if (!freeQueues_.empty())
+	{
+		int index = freeQueues_.back();
+		freeQueues_.pop_back();
+		return index;
+	}
+	int index = workQueues_.size();
+	workQueues_.emplace_back(std::make_unique<WorkStealingQueue<std::shared_ptr<TaskBase>>>());
+	workQueueSize_.store(index + 1, std::memory_order_release);
+	return index;
+}
+
+// cached模式下工作线程开始执行任务时，记录排队时间和同时忙碌的线程数量，供管理线程使用
+void ThreadPool::recordCachedLoad(PoolStatsRecorder::Clock::time_point now, PoolStatsRecorder::Clock::time_point enqueueTime)
+{
+	lastQueueWaitNs_.store(PoolStatsRecorder::elapsedNs(enqueueTime, now), std::memory_order_relaxed);
+	lastDequeueNs_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+	int busy = curThreadSize_ - idleThreadSize_;
+	int peak = peakBusySize_.load(std::memory_order_relaxed);
+	while (busy > peak && !peakBusySize_.compare_exchange_weak(peak, busy, std::memory_order_relaxed))
+	{
+	}
+}
+
+// cached模式的管理线程
+// 增加线程：有积压、没有空闲线程并且排队时间超过CACHED_GROW_WAIT时，每次增加当前线程数量的1/4；
+// 排队时间取最近开始执行的任务的排队时间，和最近一次取出任务之后积压已经持续的时间中较大的一个，
+// 这样线程全部被长任务占住、没有任务出队时也能发现积压。
+// 回收线程：每THREAD_MAX_IDLE_TIME秒为一个周期，只回收这个周期里同时忙碌的线程数量峰值以外的线程，
+// 短暂的空闲不会导致回收，负载来回波动时线程数量保持在峰值附近。
+// 没有积压时管理线程不会定时醒来，只在回收周期结束或者提交任务时发现没有空闲线程时才被唤醒。
+// 线程池停止或者切换到其他模式时退出
+void ThreadPool::managerFunc()
+{
+	using Clock = PoolStatsRecorder::Clock;
+	auto backlogSince = Clock::time_point::max();	// 管理线程观察到积压开始的时间
+	auto periodStart = Clock::now();				// 当前回收周期开始的时间
+	peakBusySize_ = 0;
+	for (;;)
+	{
+		auto now = Clock::now();
+
+		// 增加线程
+		if (taskSize_ > 0)
+		{
+			if (backlogSince == Clock::time_point::max())
+				backlogSince = now;
+			Clock::time_point lastDequeue{ Clock::duration(lastDequeueNs_.load(std::memory_order_relaxed)) };
+			auto stalled = PoolStatsRecorder::elapsedNs(std::max(lastDequeue, backlogSince), now);
+			auto wait = std::max<uint64_t>(lastQueueWaitNs_.load(std::memory_order_relaxed), stalled);
+			int room = threadSizeThreshHold_ - curThreadSize_;
+			if (idleThreadSize_ == 0 && room > 0
+				&& wait >= (uint64_t)std::chrono::nanoseconds(CACHED_GROW_WAIT).count())
+			{
+				int count = std::min({ std::max(curThreadSize_ / 4, 1), room, (int)taskSize_ });
+				addThreads(count);
+				// 新线程马上会取走积压的任务，重新开始计算排队时间
+				lastQueueWaitNs_ = 0;
+				backlogSince = Clock::time_point::max();
+			}
+		}
+		else
+		{
+			backlogSince = Clock::time_point::max();
+		}
+
+		// 回收周期结束，回收峰值以外的线程
+		if (now - periodStart >= std::chrono::seconds(THREAD_MAX_IDLE_TIME))
+		{
+			int peak = std::max(peakBusySize_.exchange(curThreadSize_ - idleThreadSize_), (int)initThreadSize_);
+			if (taskSize_ == 0)
+			{
+				// 已经在等待回收的线程不再计入，resize留下的回收要求保留
+				std::unique_lock<std::mutex> lock(taskQueMtx_);
+				int surplus = curThreadSize_ - retireSize_ - peak;
+				if (surplus > 0)
+				{
+					retireSize_ += surplus;
+					wakeAllWaiters();
+				}
+			}
+			periodStart = now;
+		}
+
+		// 有积压时按间隔检查，有多出的线程时睡到回收周期结束，否则一直睡到有积压
+		std::unique_lock<std::mutex> lock(managerMtx_);
+		if (!managerRunning())
+			return;
+		if (taskSize_ > 0 && idleThreadSize_ == 0)
+		{
+			managerCond_.wait_for(lock, CACHED_CHECK_INTERVAL);
+			continue;
+		}
+		managerSleeping_ = true;
+		if (taskSize_ > 0 && idleThreadSize_ == 0)
+		{
+			managerSleeping_ = false;
+			continue;
+		}
+		auto pred = [&]() -> bool { return !managerSleeping_ || !managerRunning(); };
+		if (curThreadSize_ > (int)initThreadSize_)
+			managerCond_.wait_until(lock, periodStart + std::chrono::seconds(THREAD_MAX_IDLE_TIME), pred);
+		else
+			managerCond_.wait(lock, pred);
+		managerSleeping_ = false;
 	}
+}
+
+// 管理线程是否需要继续运行
+bool ThreadPool::managerRunning() const
+{
+	return isPoolRunning_ && poolMode_ == PoolMode::MODE_CACHED;
+}
 
-	return Result(sp);
+// 停止管理线程
+void ThreadPool::stopManager()
+{
+	if (!manager_.joinable())
+		return;
+	{
+		std::unique_lock<std::mutex> lock(managerMtx_);
+		managerCond_.notify_all();
+	}
+	manager_.join();
 }
 
 // 开启线程池
@@ -109,86 +804,176 @@ void ThreadPool::start(int initThreadSize)
 	initThreadSize_ = initThreadSize;
 	curThreadSize_ = initThreadSize;
 
+	// 计算每个线程绑定的CPU
+	initPlacements();
+
+	// 工作窃取模式按线程数量上限预留私有队列的位置，resize增加线程时不会移动已有的队列
+	if (poolMode_ == PoolMode::MODE_STEALING)
+	{
+		workQueues_.reserve(std::max<int>(initThreadSize_, threadSizeThreshHold_));
+	}
+
 	// 创建线程对象
 	for (int i = 0; i < initThreadSize_; i++)
 	{
 		// 创建thread线程对象的时候，把线程函数给到线程对象
-		auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+		std::unique_ptr<Thread> ptr;
+		if (poolMode_ == PoolMode::MODE_STEALING)
+		{
+			ptr = std::make_unique<Thread>(std::bind(&ThreadPool::stealThreadFunc, this, std::placeholders::_1, newWorkQueue()));
+		}
+		else
+		{
+			ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc, this, std::placeholders::_1));
+		}
 		int threadId = ptr->getId();
 		threads_.emplace(threadId, std::move(ptr));
 		// threads_.emplace_back(std::move(ptr));
 	}
 
-	// 启动所有线程
-	for (int i = 0; i < threads_.size(); i++)
+	// 启动所有线程，线程id是全局生成的，不一定从0开始
+	for (auto &item : threads_)
 	{
-		threads_[i]->start();
+		item.second->start();
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_SPAWN, item.first);
 		idleThreadSize_++;
 	}
+
+	// cached模式由管理线程负责增减线程
+	if (poolMode_ == PoolMode::MODE_CACHED)
+	{
+		manager_ = std::thread(&ThreadPool::managerFunc, this);
+	}
+}
+
+// 运行中调整线程数量
+// 增加线程时先取消还没执行的回收，再创建新线程；减少线程时空闲的线程马上退出，
+// 正在执行任务的线程执行完当前任务后退出，排队的任务和正在执行的任务都不受影响。
+// 工作窃取模式下退出的线程留下的私有队列由其他线程窃取，新线程复用这些队列
+bool ThreadPool::resize(int threadSize)
+{
+	std::lock_guard<std::mutex> config(configMtx_);
+	if (!checkRunningState() || threadSize < 1)
+		return false;
+	if (poolMode_ == PoolMode::MODE_STEALING && threadSize > (int)workQueues_.capacity())
+		return false;
+
+	initThreadSize_ = threadSize;
+	int count = 0;
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		int live = curThreadSize_ - retireSize_;
+		if (live > threadSize)
+		{
+			retireSize_ += live - threadSize;
+			wakeAllWaiters();
+		}
+		else
+		{
+			count = threadSize - live;
+			// 已经登记回收的线程还没退出，直接取消回收就够了
+			int cancel = std::min<int>(retireSize_, count);
+			retireSize_ -= cancel;
+			count -= cancel;
+		}
+	}
+	if (count > 0)
+		addThreads(count);
+	return true;
+}
+
+// 当前线程按回收要求退出
+void ThreadPool::retireThread(int threadid)
+{
+	retireSize_--;
+	threads_.erase(threadid);
+	stats_.retireWorker(threadid);
+	curThreadSize_--;
+	idleThreadSize_--;
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
+	// 析构时可能正在等待最后一个线程退出
+	exitCond_.notify_all();
 }
 
 // 定义线程函数	线程池的所有线程从任务队列里面消费任务
 void ThreadPool::threadFunc(int threadid)
 {
-	auto lastTime = std::chrono::high_resolution_clock().now();
+	pinWorker(nextPlacement_++);
+	WorkerCounters* counters = stats_.addWorker(threadid);
+	auto idleSince = PoolStatsRecorder::Clock::now();
 	for (;;)
 	{
-		std::shared_ptr<Task> task;
+		// 到期的定时任务和就绪的fd任务放入任务队列
+		pollTimers();
+		pollIo();
+
+		std::shared_ptr<TaskBase> task;
+		bool spun = false;	// 这次空闲已经自旋过
 		{
 			// 先获取锁
 			std::unique_lock<std::mutex> lock(taskQueMtx_);
 
-			std::cout << "tid: " << std::this_thread::get_id() << "tring task..." << std::endl;
+			// 减少线程数量时，执行完任务的线程不等任务队列空就退出
+			if (retireSize_ > 0)
+			{
+				retireThread(threadid);
+				return;
+			}
 
 			while (taskQue_.size() == 0)
 			{
 				if (!isPoolRunning_)
 				{
 					threads_.erase(threadid);
+					stats_.retireWorker(threadid);
 					exitCond_.notify_all();
-					std::cout << "thread id: " << std::this_thread::get_id() << "exit!" 
-						<< std::endl;
+					THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
 					return;	// 线程函数结束，线程结束
 				}
 
-				if (poolMode_ == PoolMode::MODE_CACHED)
+				// 有到期的定时任务，放开锁把它们放入任务队列
+				if (timerDue())
 				{
-					if (std::cv_status::timeout == notEmpty_.wait_for(lock, std::chrono::seconds(1)))
-					{
-						auto now = std::chrono::high_resolution_clock().now();
-						auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-						if (dur.count() >= THREAD_MAX_IDLE_TIME && curThreadSize_ > initThreadSize_)
-						{
-							// 回收线程
-							threads_.erase(threadid);
-							curThreadSize_--;
-							idleThreadSize_--;
-							std::cout << "thread id: " << std::this_thread::get_id() << "exit!" << std::endl;
-							return;
-						}
-					}
+					lock.unlock();
+					pollTimers();
+					lock.lock();
+					continue;
 				}
-				else
+
+				// 阻塞之前先放开锁自旋等待，WAIT_BUSY_POLL一直自旋，只在每轮自旋结束时检查回收
+				if (waitPolicy_ != WaitPolicy::WAIT_BLOCK && !spun && retireSize_ == 0)
 				{
-					// 等待notEmpty条件
-					notEmpty_.wait(lock);
+					lock.unlock();
+					bool found = spinForTask();
+					if (!found)
+						pollIo();
+					lock.lock();
+					spun = !found && waitPolicy_ == WaitPolicy::WAIT_SPIN_PARK;
+					continue;
 				}
+
+				// 管理线程或者resize要求回收多出的空闲线程
+				if (retireSize_ > 0)
+				{
+					retireThread(threadid);
+					return;
+				}
+
+				// 等待notEmpty条件
+				waitThreadSize_++;
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_PARK);
+				waitForTask(lock);
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_UNPARK);
+				waitThreadSize_--;
 			}
 
 			idleThreadSize_--;
 
-			std::cout << "tid: " << std::this_thread::get_id() << "task OK..." << std::endl;
-
 			// 从任务队列中取一个任务出来
 			task = taskQue_.front();
 			taskQue_.pop();
 			taskSize_--;
-
-			// 如果依然有任务，通知其他线程
-			if (taskQue_.size() > 0)
-			{
-				notEmpty_.notify_all();
-			}
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
 
 			// 取出一个任务，进行通知
 			notFull_.notify_all();
@@ -199,18 +984,242 @@ void ThreadPool::threadFunc(int threadid)
 		if (task != nullptr)
 		{
 			// task->run();
-			task->exec();
+			runTask(*task, counters, idleSince);
 		}
 		idleThreadSize_++;
-		lastTime = std::chrono::high_resolution_clock().now();
 	}
 }
 
+// 工作窃取模式的线程函数	线程优先消费自己的私有队列，空闲时再去共享队列和其他线程的队列中获取任务
+void ThreadPool::stealThreadFunc(int threadid, int index)
+{
+	pinWorker(index);
+	WorkerCounters* counters = stats_.addWorker(threadid);
+	auto idleSince = PoolStatsRecorder::Clock::now();
+	curPool_ = this;
+	curQueueIndex_ = index;
+	for (;;)
+	{
+		// 减少线程数量时，执行完任务的线程退出，私有队列中剩下的任务由其他线程窃取
+		if (retireSize_ > 0)
+		{
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			if (retireSize_ > 0)
+			{
+				freeQueues_.push_back(index);
+				retireThread(threadid);
+				return;
+			}
+		}
+
+		// 到期的定时任务和就绪的fd任务放入任务队列
+		pollTimers();
+		pollIo();
+
+		std::shared_ptr<TaskBase> task;
+		if (!getStealTask(index, task))
+		{
+			// 阻塞之前先自旋等待，发现任务就回去重新获取
+			if (waitPolicy_ != WaitPolicy::WAIT_BLOCK && spinForTask())
+				continue;
+
+			std::unique_lock<std::mutex> lock(taskQueMtx_);
+			if (taskSize_ == 0 && !isPoolRunning_)
+			{
+				threads_.erase(threadid);
+				stats_.retireWorker(threadid);
+				exitCond_.notify_all();
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_RETIRE, threadid);
+				return;	// 线程函数结束，线程结束
+			}
+
+			if (waitPolicy_ == WaitPolicy::WAIT_BUSY_POLL && isPoolRunning_)
+				continue;
+
+			// 先登记等待线程数量再检查任务数量，与提交任务一方的顺序相反，保证通知不会丢失
+			// 被唤醒或者等到定时任务到期后回到循环开头重新获取
+			waitThreadSize_++;
+			if (taskSize_ == 0 && isPoolRunning_ && retireSize_ == 0 && !timerDue())
+			{
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_PARK);
+				waitForTask(lock);
+				THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_UNPARK);
+			}
+			waitThreadSize_--;
+			continue;
+		}
+
+		idleThreadSize_--;
+		runTask(*task, counters, idleSince);
+		idleThreadSize_++;
+	}
+}
+
+bool ThreadPool::getStealTask(int index, std::shared_ptr<TaskBase>& task)
+{
+	// 私有队列
+	if (workQueues_[index]->pop(task))
+	{
+		taskSize_--;
+		THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+		return true;
+	}
+
+	// 外部提交任务的共享队列
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		if (!taskQue_.empty())
+		{
+			task = taskQue_.front();
+			taskQue_.pop();
+			taskSize_--;
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+			notFull_.notify_all();
+			return true;
+		}
+	}
+
+	// 从其他线程的私有队列窃取
+	int size = workQueueSize_.load(std::memory_order_acquire);
+	for (int i = 1; i < size; i++)
+	{
+		if (workQueues_[(index + i) % size]->steal(task))
+		{
+			taskSize_--;
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 执行任务并记录排队时间、执行时间和执行前的空闲时间
+void ThreadPool::runTask(TaskBase& task, WorkerCounters* counters, PoolStatsRecorder::Clock::time_point& idleSince)
+{
+	if (discardCancelled(task))
+		return;
+	auto startTime = PoolStatsRecorder::Clock::now();
+	if (poolMode_ == PoolMode::MODE_CACHED)
+	{
+		recordCachedLoad(startTime, task.enqueueTime_);
+		wakeManagerIfBusy();
+	}
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_START);
+	{
+		CancellationToken::Scope scope(task.token_);
+		TaskArena::TaskScope arenaScope;	// 任务结束后回收临时内存
+		task.exec();
+	}
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_END);
+	auto endTime = PoolStatsRecorder::Clock::now();
+	counters->taskDone(PoolStatsRecorder::elapsedNs(task.enqueueTime_, startTime),
+					   PoolStatsRecorder::elapsedNs(startTime, endTime),
+					   PoolStatsRecorder::elapsedNs(idleSince, startTime));
+	idleSince = endTime;
+}
+
+// 在当前线程执行一个排队的任务	等待子任务的线程用它代替阻塞
+bool ThreadPool::runPendingTask()
+{
+	std::shared_ptr<TaskBase> task;
+	if (!takePendingTask(task))
+		return false;
+	if (discardCancelled(*task))
+		return true;
+	// 帮忙取走的任务同样说明积压在减少，cached模式下不会因此多创建线程
+	if (poolMode_ == PoolMode::MODE_CACHED)
+		recordCachedLoad(PoolStatsRecorder::Clock::now(), task->enqueueTime_);
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_START);
+	{
+		CancellationToken::Scope scope(task->token_);
+		TaskArena::TaskScope arenaScope;
+		task->exec();
+	}
+	THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_END);
+	stats_.taskHelped(1);
+	return true;
+}
+
+// runPendingTask取出一个任务	工作线程按窃取的顺序，外部线程先取共享队列再窃取各个线程的私有队列
+bool ThreadPool::takePendingTask(std::shared_ptr<TaskBase>& task)
+{
+	if (poolMode_ == PoolMode::MODE_STEALING && curPool_ == this)
+		return getStealTask(curQueueIndex_, task);
+
+	{
+		std::unique_lock<std::mutex> lock(taskQueMtx_);
+		if (!taskQue_.empty())
+		{
+			task = taskQue_.front();
+			taskQue_.pop();
+			taskSize_--;
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+			notFull_.notify_all();
+			return true;
+		}
+	}
+
+	if (poolMode_ != PoolMode::MODE_STEALING)
+		return false;
+	int size = workQueueSize_.load(std::memory_order_acquire);
+	for (int i = 0; i < size; i++)
+	{
+		if (workQueues_[i]->steal(task))
+		{
+			taskSize_--;
+			THREADPOOL_TRACE_EVENT(TraceEvent::TRACE_DEQUEUE);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 当前工作线程的任务临时内存	不在工作线程中时返回全局堆
+std::pmr::memory_resource* ThreadPool::localArena()
+{
+	TaskArena* arena = TaskArena::current();
+	if (arena != nullptr)
+		return arena;
+	return std::pmr::new_delete_resource();
+}
+
+// 运行统计的快照
+PoolStats ThreadPool::getStats() const
+{
+	PoolStats stats;
+	stats_.collect(stats);
+	stats.queueDepth_ = taskSize_;
+	stats.threadSize_ = curThreadSize_;
+	stats.idleThreadSize_ = idleThreadSize_;
+	return stats;
+}
+
+// 按绑定方式计算每个线程绑定的CPU
+void ThreadPool::initPlacements()
+{
+	if (affinityPolicy_ == AffinityPolicy::AFFINITY_NONE)
+		return;
+	if (!topology_)
+		topology_ = std::make_unique<CpuTopology>(CpuTopology::detect());
+	placements_ = topology_->placements(affinityPolicy_, affinityCpus_, initThreadSize_);
+}
+
+// 线程启动时绑定CPU
+void ThreadPool::pinWorker(int slot)
+{
+	if (placements_.empty())
+		return;
+	CpuTopology::pinCurrentThread(placements_[slot % placements_.size()]);
+}
+
 bool ThreadPool::checkRunningState() const
 {
 	return isPoolRunning_;
 }
 
+thread_local ThreadPool* ThreadPool::curPool_ = nullptr;
+thread_local int ThreadPool::curQueueIndex_ = -1;
+
 /// <summary>
 /// 线程方法实现
 /// </summary>
@@ -227,8 +1236,12 @@ Thread::~Thread()
 
 void Thread::start()
 {
-	// 创建一个线程来执行线程函数
-	std::thread t(func_, threadId_);
+	// 创建一个线程来执行线程函数，线程拥有自己的任务临时内存
+	std::thread t([func = func_, threadId = threadId_]() {
+		TaskArena arena;
+		TaskArena::ThreadScope scope(arena);
+		func(threadId);
+	});
 	t.detach(); // 设置分离线程
 }
 
@@ -247,34 +1260,212 @@ Task::Task()
 
 void Task::exec()
 {
+	Any val = run(); // 这里发生多态调用
 	if (result_ != nullptr)
-		result_->setVal(run()); // 这里发生多态调用
+		result_->setVal(std::move(val));
+}
+
+void Task::setResult(std::shared_ptr<ResultState<Any>> result)
+{
+	result_ = std::move(result);
 }
 
-void Task::setResult(Result *res)
+void Task::discard(std::exception_ptr reason)
 {
-	result_ = res;
+	if (result_ != nullptr)
+		result_->setError(std::move(reason));
 }
 
 /// <summary>
 /// Result方法实现
 /// </summary>
 Result::Result(std::shared_ptr<Task> task, bool isValid)
-	: isValid_(isValid), task_(task)
+	: Result(std::move(task), std::make_shared<ResultState<Any>>(), isValid)
 {
-	task_->setResult(this);
+}
+
+Result::Result(std::shared_ptr<Task> task, std::shared_ptr<ResultState<Any>> state, bool isValid)
+	: state_(std::move(state)), task_(std::move(task)), isValid_(isValid)
+{
+	task_->setResult(state_);
 }
 
 Any Result::get()
 {
-	if (!isValid_)
-		return "";
-	sem_.wait(); // task任务如果没有执行完，这里会阻塞用户的线程
-	return std::move(any_);
+	return state_->get(); // task任务如果没有执行完，这里会阻塞用户的线程；被拒绝时抛出TaskRejected
 }
 
 void Result::setVal(Any any)
 {
-	this->any_ = std::move(any);
-	sem_.post(); // 已经获取的任务的返回值，增加信号量资源
+	state_->setVal(std::move(any)); // 已经获取的任务的返回值，通知等待的线程
+}
+
+bool Result::ready() const
+{
+	return state_->ready();
+}
+
+bool Result::isValid() const
+{
+	return isValid_;
+}
+
+/// <summary>
+/// 周期任务的一次执行，执行完成后按周期安排下一次；被拒绝时跳过这一次，token取消后不再安排
+/// </summary>
+class PeriodicTask : public TaskBase
+{
+public:
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	PeriodicTask(ThreadPool* pool, std::shared_ptr<TaskBase> task, std::chrono::nanoseconds period, TimePoint due)
+		: pool_(pool), task_(std::move(task)), period_(period), due_(due)
+	{
+		setCancellationToken(task_->cancellationToken());
+	}
+
+	void exec() override
+	{
+		try
+		{
+			task_->exec();
+		}
+		catch (...)
+		{
+		}
+		rearm();
+	}
+
+	// 取消或者线程池析构时rearm不会再安排
+	void discard(std::exception_ptr) override
+	{
+		rearm();
+	}
+
+private:
+	// 安排下一次执行，错过的周期直接跳过
+	void rearm()
+	{
+		if (cancellationToken().isCancelled())
+			return;
+		auto now = std::chrono::steady_clock::now();
+		TimePoint next = due_ + period_;
+		if (next <= now)
+			next += period_ * ((now - next) / period_ + 1);
+		pool_->addTimer(std::make_shared<PeriodicTask>(pool_, task_, period_, next), next);
+	}
+
+	ThreadPool* pool_;
+	std::shared_ptr<TaskBase> task_;
+	std::chrono::nanoseconds period_;
+	TimePoint due_;	// 这一次的到期时间
+};
+
+// 周期执行任务	每一次执行由PeriodicTask包装，执行完成后安排下一次
+bool ThreadPool::scheduleEvery(std::chrono::nanoseconds period, std::shared_ptr<TaskBase> sp)
+{
+	if (period <= std::chrono::nanoseconds::zero())
+		return false;
+	TimePoint due = waitDeadline(period);
+	return addTimer(std::make_shared<PeriodicTask>(this, std::move(sp), period, due), due);
+}
+
+/// <summary>
+/// 任务组的子任务，包装用户的任务，执行完成或者被丢弃时通知任务组
+/// </summary>
+class GroupTask : public TaskBase
+{
+public:
+	GroupTask(std::shared_ptr<TaskGroupState> state, std::shared_ptr<TaskBase> task)
+		: state_(std::move(state)), task_(std::move(task))
+	{
+		setCancellationToken(state_->token());
+	}
+
+	void exec() override
+	{
+		if (task_->cancellationToken().isCancelled())
+		{
+			// 用户任务自己的token已经取消，只丢弃这一个任务，不算任务组失败
+			task_->discard(std::make_exception_ptr(TaskCancelled()));
+		}
+		else
+		{
+			try
+			{
+				task_->exec();
+			}
+			catch (...)
+			{
+				state_->childAborted(std::current_exception());
+			}
+		}
+		state_->childFinished();
+	}
+
+	void discard(std::exception_ptr reason) override
+	{
+		task_->discard(reason);
+		state_->childAborted(std::move(reason));
+		state_->childFinished();
+	}
+
+private:
+	std::shared_ptr<TaskGroupState> state_;
+	std::shared_ptr<TaskBase> task_;
+};
+
+/// <summary>
+/// TaskGroup方法实现
+/// </summary>
+TaskGroup::TaskGroup(ThreadPool& pool)
+	: pool_(pool), state_(std::make_shared<TaskGroupState>())
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	try
+	{
+		wait();
+	}
+	catch (...)
+	{
+	}
+}
+
+void TaskGroup::run(std::shared_ptr<TaskBase> sp)
+{
+	if (state_->isCancelled())
+		return;
+	state_->childStarted();
+	std::shared_ptr<TaskBase> task = std::make_shared<GroupTask>(state_, std::move(sp));
+	if (!pool_.enqueueTask(task, ThreadPool::TimePoint::min()))
+	{
+		// 队列满，由当前线程直接执行
+		CancellationToken::Scope scope(task->cancellationToken());
+		task->exec();
+	}
+}
+
+void TaskGroup::wait()
+{
+	while (state_->pending())
+	{
+		if (!pool_.runPendingTask())
+			state_->waitForChildren();
+	}
+	std::exception_ptr error = state_->takeError();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void TaskGroup::cancel()
+{
+	state_->cancel();
+}
+
+bool TaskGroup::isCancelled() const
+{
+	return state_->isCancelled();
 }
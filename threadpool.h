@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 #include <memory>
 #include <atomic>
 #include <mutex>
@@ -10,56 +11,200 @@
 #include <functional>
 #include <unordered_map>
 #include <thread>
+#include <optional>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <chrono>
+#include <climits>
+#include <exception>
+#include <typeinfo>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+#include "final/tracer.h"
+#include "final/poolstats.h"
+#include "final/waitpolicy.h"
+#include "final/rejectpolicy.h"
+#include "final/cancellation.h"
+#include "final/taskarena.h"
+#include "final/statepool.h"
+#include "final/taskgroupstate.h"
+#include "final/timerwheel.h"
+#include "final/iopoller.h"
+#include "final/cputopology.h"
+
+// Any内联存储的大小，不超过这个大小的数据不分配堆内存
+const size_t ANY_INLINE_SIZE = 32;
+
+/// <summary>
+/// Any::cast_的类型和存放的数据类型不一致，或者Any是空的
+/// </summary>
+class AnyCastError : public std::bad_cast
+{
+public:
+	const char* what() const noexcept override
+	{
+		return "type is unmatch!";
+	}
+};
 
 /// <summary>
 /// Any类型，可以接收任意数据的类型
+/// 小对象直接存放在Any内部，大对象才在堆上分配；支持只能移动的类型
 /// </summary>
 class Any
 {
 public:
-	Any() = default;
-	~Any() = default;
+	Any() : ops_(nullptr)
+	{}
+	~Any()
+	{
+		reset();
+	}
 	Any(const Any&) = delete;
 	Any& operator=(const Any&) = delete;
-	Any(Any&&) = default;
-	Any& operator=(Any&&) = default;
+	Any(Any&& other) noexcept : ops_(other.ops_)
+	{
+		if (ops_ != nullptr)
+		{
+			ops_->move(buf_, other.buf_);
+			other.ops_ = nullptr;
+		}
+	}
+	Any& operator=(Any&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.ops_ != nullptr)
+			{
+				other.ops_->move(buf_, other.buf_);
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Any>>>
+	Any(T&& data)
+	{
+		using U = std::decay_t<T>;
+		if constexpr (isInline<U>())
+		{
+			new (buf_) U(std::forward<T>(data));
+			ops_ = &InlineOps<U>::ops;
+		}
+		else
+		{
+			*reinterpret_cast<U**>(buf_) = new U(std::forward<T>(data));
+			ops_ = &HeapOps<U>::ops;
+		}
+	}
 
+	// 提取data_数据，拷贝一份；类型不匹配时抛出AnyCastError
 	template<typename T>
-	Any(T data) : base_(std::make_unique<Derive<T>>(data))
-	{}
+	T cast_() &
+	{
+		return *data<T>();
+	}
 
-	// 提取data_数据
+	// 提取data_数据，Any是右值时直接移动出来，支持只能移动的类型
 	template<typename T>
-	T cast_()
+	T cast_() &&
 	{
-		// 基类指针  -》 派生类指针    RTTI
-		Derive<T>* pd = dynamic_cast<Derive<T>*>(base_.get());
-		if (pd == nullptr)
-		{
-			throw "type is unmatch!";
-		}
-		return pd->data_;
+		return std::move(*data<T>());
 	}
+
 private:
-	// 基类类型
-	class Base
+	// 每种数据类型一份操作表，操作表的地址同时作为类型标识，不需要RTTI
+	struct Ops
 	{
-	public:
-		virtual ~Base() = default;
+		void (*move)(void* dst, void* src); // 把src的数据移动到dst，并析构src中的数据
+		void (*destroy)(void* buf);
+		void* (*get)(void* buf);
 	};
 
-	// 派生类类型
 	template<typename T>
-	class Derive : public Base
+	static constexpr bool isInline()
 	{
-	public:
-		Derive(T data) : data_(data)
-		{}
-		T data_;	// 保存了任意的其他类型
+		return sizeof(T) <= ANY_INLINE_SIZE
+			&& alignof(T) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<T>;
+	}
+
+	template<typename T>
+	struct InlineOps
+	{
+		static void move(void* dst, void* src)
+		{
+			T* p = static_cast<T*>(src);
+			new (dst) T(std::move(*p));
+			p->~T();
+		}
+		static void destroy(void* buf)
+		{
+			static_cast<T*>(buf)->~T();
+		}
+		static void* get(void* buf)
+		{
+			return buf;
+		}
+		static constexpr Ops ops = { &move, &destroy, &get };
+	};
+
+	template<typename T>
+	struct HeapOps
+	{
+		static void move(void* dst, void* src)
+		{
+			*static_cast<T**>(dst) = *static_cast<T**>(src);
+		}
+		static void destroy(void* buf)
+		{
+			delete *static_cast<T**>(buf);
+		}
+		static void* get(void* buf)
+		{
+			return *static_cast<T**>(buf);
+		}
+		static constexpr Ops ops = { &move, &destroy, &get };
 	};
+
+	// 类型匹配时返回数据的指针
+	template<typename T>
+	T* data()
+	{
+		const Ops* ops;
+		if constexpr (isInline<T>())
+			ops = &InlineOps<T>::ops;
+		else
+			ops = &HeapOps<T>::ops;
+		if (ops_ == nullptr || ops_ != ops)
+		{
+			throw AnyCastError();
+		}
+		return static_cast<T*>(ops_->get(buf_));
+	}
+
+	void reset()
+	{
+		if (ops_ != nullptr)
+		{
+			ops_->destroy(buf_);
+			ops_ = nullptr;
+		}
+	}
+
 private:
-	// 基类指针
-	std::unique_ptr<Base> base_;
+	alignas(std::max_align_t) unsigned char buf_[ANY_INLINE_SIZE];
+	const Ops* ops_;	// 指向数据类型对应的操作表
 };
 
 /// <summary>
@@ -99,6 +244,191 @@ private:
 	std::condition_variable cond_;
 };
 
+// 一次性完成事件等待时，阻塞前的自旋次数
+const int EVENT_SPIN_COUNT = 128;
+
+/// <summary>
+/// 一次性完成事件，代替Result中的Semaphore
+/// 已经完成时wait()只读一次原子变量；没有完成时先短暂自旋，再阻塞等待；
+/// set()只有在确实有线程阻塞时才去唤醒。Linux上直接用futex阻塞，其他平台用条件变量
+/// </summary>
+class CompletionEvent
+{
+public:
+	CompletionEvent() : state_(EVENT_EMPTY)
+	{}
+	CompletionEvent(const CompletionEvent&) = delete;
+	CompletionEvent& operator=(const CompletionEvent&) = delete;
+
+	// 是否已经完成，不阻塞
+	bool ready() const
+	{
+		return state_.load(std::memory_order_acquire) == EVENT_DONE;
+	}
+
+	// 标记完成，唤醒所有等待的线程
+	void set()
+	{
+		if (state_.exchange(EVENT_DONE, std::memory_order_acq_rel) == EVENT_WAITING)
+		{
+			wakeAll();
+		}
+	}
+
+	// 等待完成
+	void wait()
+	{
+		if (spinWait())
+			return;
+		while (markWaiting())
+		{
+			sleep(nullptr);
+		}
+	}
+
+	// 最多等待timeout时间，返回是否已经完成
+	template<typename Rep, typename Period>
+	bool waitFor(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		if (spinWait())
+			return true;
+		while (markWaiting())
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (now >= deadline)
+				return ready();
+			auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+			sleep(&left);
+		}
+		return true;
+	}
+
+private:
+	// 短暂自旋等待，返回是否已经完成
+	bool spinWait() const
+	{
+		for (int i = 0; i < EVENT_SPIN_COUNT; i++)
+		{
+			if (ready())
+				return true;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+			__builtin_ia32_pause();
+#endif
+		}
+		return ready();
+	}
+
+	// 登记有线程要阻塞等待，返回false表示已经完成不需要等待
+	bool markWaiting()
+	{
+		int state = EVENT_EMPTY;
+		if (state_.compare_exchange_strong(state, EVENT_WAITING, std::memory_order_acq_rel))
+			return true;
+		return state == EVENT_WAITING;
+	}
+
+#ifdef __linux__
+	// 状态依然是EVENT_WAITING时阻塞，timeout为空表示不限时
+	void sleep(const std::chrono::nanoseconds* timeout)
+	{
+		static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain int");
+		struct timespec ts;
+		struct timespec* pts = nullptr;
+		if (timeout != nullptr)
+		{
+			ts.tv_sec = timeout->count() / 1000000000;
+			ts.tv_nsec = timeout->count() % 1000000000;
+			pts = &ts;
+		}
+		syscall(SYS_futex, reinterpret_cast<int*>(&state_), FUTEX_WAIT_PRIVATE,
+				EVENT_WAITING, pts, nullptr, 0);
+	}
+
+	void wakeAll()
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(&state_), FUTEX_WAKE_PRIVATE,
+				INT_MAX, nullptr, nullptr, 0);
+	}
+#else
+	void sleep(const std::chrono::nanoseconds* timeout)
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		auto pred = [&]() -> bool { return ready(); };
+		if (timeout == nullptr)
+			cond_.wait(lock, pred);
+		else
+			cond_.wait_for(lock, *timeout, pred);
+	}
+
+	void wakeAll()
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		cond_.notify_all();
+	}
+
+	std::mutex mtx_;
+	std::condition_variable cond_;
+#endif
+
+private:
+	static const int EVENT_EMPTY = 0;	// 没有完成，没有线程阻塞
+	static const int EVENT_WAITING = 1;	// 没有完成，有线程阻塞
+	static const int EVENT_DONE = 2;	// 已经完成
+
+	std::atomic<int> state_;
+};
+
+/// <summary>
+/// 任务返回值的共享状态，任务对象和用户拿到的结果对象各持有一份
+/// 用户先释放结果对象也不会影响任务写入返回值
+/// </summary>
+template<typename T>
+class ResultState
+{
+public:
+	// 任务执行完成，写入返回值
+	void setVal(T val)
+	{
+		val_.emplace(std::move(val));
+		event_.set();
+	}
+
+	// 任务没有执行就被丢弃，get()抛出reason
+	void setError(std::exception_ptr reason)
+	{
+		error_ = std::move(reason);
+		event_.set();
+	}
+
+	// 等待任务执行完成，取出返回值
+	T get()
+	{
+		event_.wait(); // task任务如果没有执行完，这里会阻塞用户的线程
+		if (error_)
+			std::rethrow_exception(error_);
+		return std::move(*val_);
+	}
+
+	// 任务是否已经执行完成
+	bool ready() const
+	{
+		return event_.ready();
+	}
+
+	// 最多等待timeout时间，返回任务是否已经执行完成
+	template<typename Rep, typename Period>
+	bool waitFor(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return event_.waitFor(timeout);
+	}
+
+private:
+	std::optional<T> val_;	// 存储任务的返回值
+	std::exception_ptr error_;	// 任务被丢弃的原因
+	CompletionEvent event_;	// 任务完成事件
+};
+
 /// <summary>
 /// 实现接收提交到线程池的task任务执行完成后的返回值类型Result
 /// </summary>
@@ -107,23 +437,109 @@ class Result
 {
 public:
 	Result(std::shared_ptr<Task> task, bool isValid = true);
+	// 使用给定的共享状态，线程池从自己的内存池分配共享状态
+	Result(std::shared_ptr<Task> task, std::shared_ptr<ResultState<Any>> state, bool isValid = true);
 	~Result() = default;
+	Result(Result&&) = default;
+	Result& operator=(Result&&) = default;
 
 	void setVal(Any any);
 
+	// 等待任务执行完成，取出返回值；任务被拒绝或者被丢弃时抛出TaskRejected
 	Any get();
 
+	// 任务是否已经执行完成，不阻塞
+	bool ready() const;
+
+	// 任务是否放进了线程池，提交失败时返回false
+	bool isValid() const;
+
+	// 最多等待timeout时间，返回任务是否已经执行完成
+	template<typename Rep, typename Period>
+	bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return state_->waitFor(timeout);
+	}
+
 private:
-	Any any_;	// 存储任务的返回值
-	Semaphore sem_;	// 线程通信信号量
+	std::shared_ptr<ResultState<Any>> state_;	// 存储任务的返回值
 	std::shared_ptr<Task> task_;	// 指向对应获取返回值的任务对象
-	std::atomic_bool isValid_;	// 返回值是否有效
+	bool isValid_;	// 返回值是否有效
+};
+
+/// <summary>
+/// 带类型的任务返回值，不经过Any，返回值直接以T类型保存
+/// </summary>
+template<typename T>
+class TypedResult
+{
+public:
+	TypedResult(std::shared_ptr<ResultState<T>> state, bool isValid = true)
+		: state_(std::move(state)), isValid_(isValid)
+	{}
+
+	// 等待任务执行完成，取出返回值；任务被拒绝或者被丢弃时抛出TaskRejected
+	T get()
+	{
+		return state_->get();
+	}
+
+	// 任务是否已经执行完成，不阻塞
+	bool ready() const
+	{
+		return state_->ready();
+	}
+
+	// 任务是否放进了线程池，提交失败时返回false
+	bool isValid() const
+	{
+		return isValid_;
+	}
+
+	// 最多等待timeout时间，返回任务是否已经执行完成
+	template<typename Rep, typename Period>
+	bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return state_->waitFor(timeout);
+	}
+
+private:
+	std::shared_ptr<ResultState<T>> state_;
+	bool isValid_;	// 返回值是否有效
+};
+
+/// <summary>
+/// 线程池执行的任务的公共基类
+/// </summary>
+class TaskBase
+{
+public:
+	virtual ~TaskBase() = default;
+	// 线程池线程执行任务并写入返回值
+	virtual void exec() = 0;
+	// 任务没有执行就被丢弃，结果对象报告reason
+	virtual void discard(std::exception_ptr reason) = 0;
+
+	// 提交之前设置取消token，取出时已经取消或者超过截止时间的任务不执行，结果对象报告TaskCancelled
+	void setCancellationToken(CancellationToken token)
+	{
+		token_ = std::move(token);
+	}
+	// run方法中轮询token，发现取消时尽早返回
+	const CancellationToken& cancellationToken() const
+	{
+		return token_;
+	}
+private:
+	friend class ThreadPool;
+	PoolStatsRecorder::Clock::time_point enqueueTime_;	// 放入任务队列的时间，用来统计排队时间
+	CancellationToken token_;
 };
 
 /// <summary>
 /// 任务抽象基类
 /// </summary>
-class Task
+class Task : public TaskBase
 {
 public:
 	Task();
@@ -131,10 +547,41 @@ public:
 	// 用户可以自定义任意任务类型，继承于Task，重写run方法，实现自定义任务处理
 	virtual Any run() = 0;
 
-	void setResult(Result *res);
-	void exec();
+	void setResult(std::shared_ptr<ResultState<Any>> result);
+	void exec() override;
+	void discard(std::exception_ptr reason) override;
 private:
-	Result *result_;
+	std::shared_ptr<ResultState<Any>> result_;
+};
+
+/// <summary>
+/// 带类型的任务抽象基类，run方法直接返回T，返回值不经过Any
+/// </summary>
+template<typename T>
+class TypedTask : public TaskBase
+{
+public:
+	using ValueType = T;
+	// 用户继承于TypedTask<T>，重写run方法
+	virtual T run() = 0;
+
+	void setResult(std::shared_ptr<ResultState<T>> result)
+	{
+		result_ = std::move(result);
+	}
+	void exec() override
+	{
+		T val = run();
+		if (result_ != nullptr)
+			result_->setVal(std::move(val));
+	}
+	void discard(std::exception_ptr reason) override
+	{
+		if (result_ != nullptr)
+			result_->setError(std::move(reason));
+	}
+private:
+	std::shared_ptr<ResultState<T>> result_;
 };
 
 /// <summary>
@@ -144,6 +591,55 @@ enum class PoolMode
 {
 	MODE_FIXED,	// 固定数量的线程
 	MODE_CACHED,// 线程数量可动态增长
+	MODE_STEALING,// 工作窃取，每个线程拥有自己的任务队列
+};
+
+/// <summary>
+/// 工作窃取模式下线程私有的任务队列
+/// 所属线程从尾部存取任务（后进先出，缓存友好），其他线程从头部窃取任务
+/// </summary>
+template<typename T>
+class alignas(64) WorkStealingQueue
+{
+public:
+	// 所属线程放入任务
+	void push(T item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		que_.emplace_back(std::move(item));
+	}
+	// 所属线程取出最近放入的任务
+	bool pop(T& item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (que_.empty())
+			return false;
+		item = std::move(que_.back());
+		que_.pop_back();
+		return true;
+	}
+	// 所属线程批量放入任务，只加一次锁
+	void pushBatch(std::vector<T>& items)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		for (auto &item : items)
+		{
+			que_.emplace_back(std::move(item));
+		}
+	}
+	// 其他线程窃取最早放入的任务
+	bool steal(T& item)
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (que_.empty())
+			return false;
+		item = std::move(que_.front());
+		que_.pop_front();
+		return true;
+	}
+private:
+	std::deque<T> que_;
+	std::mutex mtx_;
 };
 
 /// <summary>
@@ -180,49 +676,369 @@ public:
 	// 线程池析构
 	~ThreadPool();
 
-	// 设置线程池工作模式
+	// 设置线程池工作模式	运行中可以在fixed和cached之间切换，工作窃取模式不能和其他模式互相切换
 	void setMode(PoolMode mode);
 
-	// 设置任务队列上限阈值
+	// 设置任务队列上限阈值	运行中修改对之后的提交生效
 	void setTaskQueMaxThreshHold(int threshhold);
 
-	// 设置线程池cached模式下线程阈值
+	// 设置线程池cached模式下线程阈值，工作窃取模式下在start之前设置，是resize能达到的线程数量上限
 	void setThreadSizeThreshHold(int threshhold);
+
+	// 设置工作线程空闲时的等待方式，spinRounds为阻塞前自旋的轮数
+	void setWaitPolicy(WaitPolicy policy, int spinRounds = WAIT_SPIN_ROUNDS);
+
+	// 设置任务队列满、等待超时后的拒绝策略
+	void setRejectPolicy(RejectPolicy policy);
+
+	// 设置submitTask和submitBatch在任务队列满时最长的等待时间，超时后按拒绝策略处理
+	void setSubmitTimeout(std::chrono::nanoseconds timeout);
+
+	// 设置工作线程绑定CPU的方式，AFFINITY_LIST时cpus为CPU编号列表，线程依次绑定、循环使用
+	void setAffinity(AffinityPolicy policy, std::vector<int> cpus = {});
+
+	// 使用给定的CPU拓扑代替自动检测，比如只使用部分NUMA节点
+	void setCpuTopology(CpuTopology topology);
 	
-	// 给线程池提交任务
+	// 给线程池提交任务，任务队列满时最多等待submitTimeout，之后按拒绝策略处理
 	Result submitTask(std::shared_ptr<Task> sp);
 
+	// 提交不需要结果的任务，不创建结果对象，Task和TypedTask都可以
+	// 队列满时最多等待submitTimeout，之后按拒绝策略处理，任务被丢弃时返回false
+	bool post(std::shared_ptr<TaskBase> sp);
+
+	// 给线程池提交任务，任务队列满时最多等待timeout，之后按拒绝策略处理
+	Result submitFor(std::shared_ptr<Task> sp, std::chrono::nanoseconds timeout);
+
+	// 尝试提交任务，从不阻塞；任务队列满时不使用拒绝策略，返回isValid()为false的结果
+	Result trySubmit(std::shared_ptr<Task> sp);
+
+	// 给线程池提交带类型的任务，返回值不经过Any
+	template<typename TaskT, typename = std::enable_if_t<
+		std::is_base_of_v<TypedTask<typename TaskT::ValueType>, TaskT>>>
+	TypedResult<typename TaskT::ValueType> submitTask(std::shared_ptr<TaskT> sp)
+	{
+		return submitTypedTask(std::move(sp), submitTimeout_, true);
+	}
+
+	template<typename TaskT, typename = std::enable_if_t<
+		std::is_base_of_v<TypedTask<typename TaskT::ValueType>, TaskT>>>
+	TypedResult<typename TaskT::ValueType> submitFor(std::shared_ptr<TaskT> sp, std::chrono::nanoseconds timeout)
+	{
+		return submitTypedTask(std::move(sp), timeout, true);
+	}
+
+	template<typename TaskT, typename = std::enable_if_t<
+		std::is_base_of_v<TypedTask<typename TaskT::ValueType>, TaskT>>>
+	TypedResult<typename TaskT::ValueType> trySubmit(std::shared_ptr<TaskT> sp)
+	{
+		return submitTypedTask(std::move(sp), std::chrono::nanoseconds::min(), false);
+	}
+
+	// 批量提交任务，区间中的每个元素是std::shared_ptr<Task>
+	// 所有任务在一次加锁中放入任务队列，并且只唤醒需要的线程数量；
+	// 队列满时整批最多等待submitTimeout，没放入的任务按拒绝策略处理
+	template<typename Iter>
+	std::vector<Result> submitBatch(Iter first, Iter last)
+	{
+		std::vector<Result> results;
+		std::vector<std::shared_ptr<TaskBase>> tasks;
+		for (; first != last; ++first)
+		{
+			std::shared_ptr<Task> sp = *first;
+			results.emplace_back(sp, newResultState<Any>());
+			tasks.emplace_back(std::move(sp));
+		}
+		size_t done = enqueueBatch(tasks, waitDeadline(submitTimeout_));
+		for (size_t i = done; i < tasks.size(); i++)
+		{
+			if (!rejectTask(tasks[i]))
+			{
+				results[i] = Result(std::static_pointer_cast<Task>(tasks[i]), newResultState<Any>(), false);
+				failTask(*tasks[i]);
+			}
+		}
+		return results;
+	}
+
+	// 延迟delay之后执行任务，到期后和普通任务一样放入任务队列，等待期间不占用工作线程
+	// 线程池没有运行时返回isValid()为false的结果，线程池析构时还没到期的任务报告TaskCancelled
+	Result scheduleAfter(std::chrono::nanoseconds delay, std::shared_ptr<Task> sp);
+
+	// 每隔period执行一次任务，第一次在period之后执行；上一次执行完才安排下一次，不会重叠执行，
+	// 执行时间超过周期时跳过错过的周期。任务的取消token取消后不再执行，任务抛出的异常被忽略；
+	// 队列满被拒绝时只跳过这一次。period不是正数或者线程池没有运行时返回false
+	bool scheduleEvery(std::chrono::nanoseconds period, std::shared_ptr<TaskBase> sp);
+
+	// fd可读时执行任务，等待期间不占用工作线程，就绪后和普通任务一样放入任务队列
+	// 只触发一次，需要继续等待时在任务中再次提交；对端关闭或者出错也算就绪，由任务自己读出结果。
+	// 线程池没有运行、fd上已经有任务在等待可读或者fd不支持epoll时返回isValid()为false的结果，
+	// 线程池析构或者cancelIo时还在等待的任务报告TaskCancelled
+	Result submitOnReadable(int fd, std::shared_ptr<Task> sp);
+
+	// fd可写时执行任务，规则和submitOnReadable相同，同一个fd可以同时等待可读和可写
+	Result submitOnWritable(int fd, std::shared_ptr<Task> sp);
+
+	// 取消fd上还在等待的任务并报告TaskCancelled，返回取消的任务数量；关闭fd之前要调用
+	size_t cancelIo(int fd);
+
 	// 开启线程池
 	void start(int initThreadSize = std::thread::hardware_concurrency());
 
+	// 运行中调整线程数量，cached模式下调整的是核心线程数量，工作窃取模式下不能超过线程数量上限
+	// 正在执行任务的线程执行完当前任务后退出，线程池没有启动或者线程数量超出范围时返回false
+	bool resize(int threadSize);
+
+	// 运行统计的快照，计数器在读取时才汇总
+	PoolStats getStats() const;
+
+	// 当前工作线程的任务临时内存，任务返回后自动回收；不在工作线程中时返回全局堆
+	static std::pmr::memory_resource* localArena();
+
+	// 在当前线程执行一个排队的任务，没有可以执行的任务时返回false
+	// 等待子任务的线程用它代替阻塞：工作线程先执行自己私有队列中的任务，再去共享队列和其他线程的队列中获取
+	bool runPendingTask();
+
 	ThreadPool(const ThreadPool&) = delete;
 	ThreadPool& operator=(const ThreadPool&) = delete;
 
 private:
+	// 任务组队列满时不等待，直接放入任务队列
+	friend class TaskGroup;
+	// 周期任务执行完成后重新加入时间轮
+	friend class PeriodicTask;
+
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	// 提交带类型的任务，applyPolicy为false时队列满直接返回提交失败
+	template<typename TaskT>
+	TypedResult<typename TaskT::ValueType> submitTypedTask(std::shared_ptr<TaskT> sp, std::chrono::nanoseconds timeout, bool applyPolicy)
+	{
+		using T = typename TaskT::ValueType;
+		auto state = newResultState<T>();
+		sp->setResult(state);
+		std::shared_ptr<TaskBase> task = sp;
+		if (!enqueueTask(task, waitDeadline(timeout)) && !(applyPolicy && rejectTask(task)))
+		{
+			failTask(*task);
+			return TypedResult<T>(state, false);
+		}
+		return TypedResult<T>(state);
+	}
+
+	// 从内存池分配的结果共享状态，最后一个引用释放后内存回到内存池
+	template<typename T>
+	std::shared_ptr<ResultState<T>> newResultState()
+	{
+		return std::allocate_shared<ResultState<T>>(StateAllocator<ResultState<T>>(statePool_));
+	}
+
+	// 等待timeout对应的时间点，timeout过长时一直等待
+	static TimePoint waitDeadline(std::chrono::nanoseconds timeout);
+
+	// 把任务放入任务队列，队列满时最多等待到waitUntil，返回false表示提交失败
+	bool enqueueTask(std::shared_ptr<TaskBase> sp, TimePoint waitUntil);
+
+	// 批量把任务放入任务队列，队列满时最多等待到waitUntil，返回成功放入的任务数量
+	size_t enqueueBatch(std::vector<std::shared_ptr<TaskBase>>& tasks, TimePoint waitUntil);
+
+	// 按拒绝策略处理没能放入任务队列的任务，返回false表示任务提交失败，需要调用方调用failTask
+	bool rejectTask(std::shared_ptr<TaskBase> sp);
+
+	// 任务提交失败或者被挤出队列，结果对象报告TaskRejected
+	void failTask(TaskBase& task);
+
+	// 任务已经取消时丢弃，结果对象报告TaskCancelled
+	bool discardCancelled(TaskBase& task);
+
+	// 丢弃任务队列中最早的任务，把sp放进去
+	bool replaceOldest(std::shared_ptr<TaskBase> sp);
+
+	// 唤醒所有阻塞等待任务的线程，包括在epoll_wait中的线程，调用方需要持有taskQueMtx_
+	void wakeAllWaiters();
+
+	// 唤醒count个阻塞等待任务的线程，调用方需要持有taskQueMtx_
+	void wakeWorkers(size_t count);
+
+	// 不持有taskQueMtx_时唤醒count个线程
+	void wakeWorkersUnlocked(size_t count);
+
+	// 不持有锁自旋等待任务，发现任务返回true
+	bool spinForTask();
+
+	// cached模式下有积压并且没有空闲线程时唤醒管理线程
+	void wakeManagerIfBusy();
+
+	// 把任务加入时间轮，到期后放入任务队列，线程池没有运行时返回false
+	bool addTimer(std::shared_ptr<TaskBase> sp, TimePoint due);
+
+	// 是否有已经到期的定时任务，没有定时任务时不读取时钟
+	bool timerDue() const;
+
+	// 把到期的定时任务批量放入任务队列，调用方不能持有taskQueMtx_
+	void pollTimers();
+
+	// fd上等待的任务
+	Result submitOnReady(int fd, IoEvent event, std::shared_ptr<Task> sp);
+
+	// 等待fd就绪，失败时返回false
+	bool addWatch(int fd, IoEvent event, std::shared_ptr<TaskBase> sp);
+
+	// 没有线程在epoll_wait时检查一次就绪的fd，调用方不能持有taskQueMtx_
+	void pollIo();
+
+	// 到期的定时任务和就绪的fd任务批量放入任务队列，调用方不能持有taskQueMtx_
+	void enqueueReady(std::vector<std::shared_ptr<TaskBase>>& ready);
+
+	// 阻塞等待任务，有定时任务或者等待中的fd时由一个空闲线程限时等待或者在epoll_wait中等待，调用方持有taskQueMtx_
+	void waitForTask(std::unique_lock<std::mutex>& lock);
+
+	// 放开taskQueMtx_在epoll_wait中等待fd就绪，最多等到next
+	void waitForIo(std::unique_lock<std::mutex>& lock, int64_t next);
+
+	// 创建count个新线程
+	void addThreads(int count);
+
+	// 工作窃取模式下给新线程分配私有队列，先复用退出的线程留下的队列，返回队列下标
+	int newWorkQueue();
+
+	// cached模式下记录排队时间和同时忙碌的线程数量
+	void recordCachedLoad(PoolStatsRecorder::Clock::time_point now, PoolStatsRecorder::Clock::time_point enqueueTime);
+
+	// cached模式的管理线程，根据排队时间增加线程，按忙碌线程数量的峰值回收线程
+	void managerFunc();
+
+	// 管理线程是否需要继续运行
+	bool managerRunning() const;
+
+	// 停止管理线程，调用方需要持有configMtx_
+	void stopManager();
+
+	// 当前线程按回收要求退出，调用方需要持有taskQueMtx_并且retireSize_大于0
+	void retireThread(int threadid);
+
 	// 定义线程函数
 	void threadFunc(int threadid);
 
+	// 工作窃取模式下的线程函数，index为线程私有队列的下标
+	void stealThreadFunc(int threadid, int index);
+
+	// 工作窃取模式下依次从私有队列、共享队列、其他线程的队列中获取任务
+	bool getStealTask(int index, std::shared_ptr<TaskBase>& task);
+
+	// runPendingTask取出一个任务，线程池外部的线程在工作窃取模式下也会去窃取各个线程的私有队列
+	bool takePendingTask(std::shared_ptr<TaskBase>& task);
+
+	// 执行任务并记录排队时间、执行时间和执行前的空闲时间
+	void runTask(TaskBase& task, WorkerCounters* counters, PoolStatsRecorder::Clock::time_point& idleSince);
+
+	// 按绑定方式计算每个线程绑定的CPU
+	void initPlacements();
+
+	// 线程启动时绑定CPU，cached模式新增的线程按顺序循环使用已计算的绑定
+	void pinWorker(int slot);
+
 	bool checkRunningState() const;
 
 private:
 	// std::vector<std::unique_ptr<Thread>> threads_; 
 	std::unordered_map<int, std::unique_ptr<Thread>> threads_;	// 线程列表
-	size_t initThreadSize_; // 初始的线程数量
+	std::atomic_int initThreadSize_; // 核心线程数量，初始为start的参数，resize可以修改
 	std::atomic_int curThreadSize_;	// 当前线程池线程数量
-	int threadSizeThreshHold_;	// 线程数量上限阈值
+	std::atomic_int threadSizeThreshHold_;	// 线程数量上限阈值
 	std::atomic_int idleThreadSize_;	// 空闲线程数量
 
-	std::queue<std::shared_ptr<Task>> taskQue_; // 任务队列
+	std::queue<std::shared_ptr<TaskBase>> taskQue_; // 任务队列
 	std::atomic_uint taskSize_; // 任务的数量
-	int taskQueMaxThreshHold_; // 任务队列的阈值
+	std::atomic_int taskQueMaxThreshHold_; // 任务队列的阈值，运行中可以修改
 
 	std::mutex taskQueMtx_; // 保证任务队列线程安全
 	std::condition_variable notFull_; // 表示任务队列不满
 	std::condition_variable notEmpty_; // 表示任务队列不空
 	std::condition_variable exitCond_;	// 等待线程资源全部回收
 
-	PoolMode poolMode_; // 当前线程池工作模式
+	// 工作窃取模式下每个线程私有的任务队列，taskQue_作为外部提交任务的共享队列
+	std::vector<std::unique_ptr<WorkStealingQueue<std::shared_ptr<TaskBase>>>> workQueues_;
+	std::atomic_int workQueueSize_;	// 已经创建的私有队列数量，窃取的线程只访问这些队列
+	std::vector<int> freeQueues_;	// 退出的线程留下的私有队列下标，由taskQueMtx_保护
+
+	// 绑定CPU
+	AffinityPolicy affinityPolicy_;
+	std::vector<int> affinityCpus_;	// AFFINITY_LIST使用的CPU列表
+	std::unique_ptr<CpuTopology> topology_;	// 不设置时在start中自动检测
+	std::vector<std::vector<int>> placements_;	// 每个线程绑定的CPU集合
+	std::atomic_int nextPlacement_;	// 普通模式下一个启动的线程使用的绑定
+	std::atomic_int waitThreadSize_;	// 阻塞等待任务的线程数量
+	WaitPolicy waitPolicy_;	// 空闲时的等待方式
+	int spinRounds_;	// 阻塞前自旋的轮数
+	std::atomic_int spinThreadSize_;	// 正在自旋等待任务的线程数量
+	RejectPolicy rejectPolicy_;	// 任务队列满、等待超时后的拒绝策略
+	std::chrono::nanoseconds submitTimeout_;	// submitTask在任务队列满时最长的等待时间
+
+	std::shared_ptr<StatePool> statePool_;	// 结果共享状态的内存池
+
+	// 延迟任务和周期任务
+	std::mutex timerMtx_;	// 保护timers_，不和taskQueMtx_同时持有
+	TimerWheel<std::shared_ptr<TaskBase>> timers_;	// 还没到期的定时任务
+	std::atomic<int64_t> nextTimerNs_;	// timers_最早需要推进的时间，没有定时任务时为TimePoint::max()
+	bool timerKeeper_;	// 有空闲线程在限时等待定时任务到期或者在epoll_wait中，由taskQueMtx_保护
+
+	// 等待fd就绪的任务
+	IoPoller<std::shared_ptr<TaskBase>> ioPoller_;	// 还没就绪的fd任务，由一个空闲线程在epoll_wait中等待
+	std::atomic_bool ioPolling_;	// 有线程在epoll_wait中，在taskQueMtx_中设置为true
+
+	PoolStatsRecorder stats_;	// 运行统计
+
+	// cached模式的管理线程
+	std::thread manager_;
+	std::mutex managerMtx_;
+	std::condition_variable managerCond_;
+	std::atomic_bool managerSleeping_;	// 管理线程在等待唤醒
+	std::atomic_int retireSize_;	// 需要回收的线程数量，在taskQueMtx_保护下修改
+	std::atomic_int peakBusySize_;	// 当前回收周期内同时忙碌的线程数量峰值
+	std::atomic<uint64_t> lastQueueWaitNs_;	// 最近开始执行的任务的排队时间
+	std::atomic<int64_t> lastDequeueNs_;	// 最近开始执行任务的时间
+
+	static thread_local ThreadPool* curPool_;	// 当前线程所属的线程池
+	static thread_local int curQueueIndex_;	// 当前线程私有队列的下标
+
+	std::atomic<PoolMode> poolMode_; // 当前线程池工作模式，运行中可以在fixed和cached之间切换
+	std::mutex configMtx_;	// 串行化运行中的setMode和resize
 	std::atomic_bool isPoolRunning_;	// 线程池运行状态
 };
 
+/// <summary>
+/// 结构化的任务组：run提交子任务，wait等待所有子任务结束，cancel取消还没开始执行的子任务
+/// wait不阻塞当前线程，子任务没有全部结束时执行线程池中排队的任务（包括自己的子任务），
+/// 所以在工作线程中递归地拆分任务、等待子任务，固定数量的线程也能跑满而不会死锁。
+/// 子任务抛出的第一个异常由wait抛出，同时取消其他还没开始执行的子任务
+/// </summary>
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& pool);
+	// 析构时等待还没结束的子任务，子任务的异常被忽略
+	~TaskGroup();
+
+	// 提交子任务，Task和TypedTask都可以，和post一样不创建结果对象
+	// 任务队列满时不等待也不使用拒绝策略，由当前线程直接执行子任务；任务组已经取消时不再提交
+	void run(std::shared_ptr<TaskBase> sp);
+
+	// 等待所有子任务结束，等待期间执行线程池中排队的任务；有子任务失败时抛出第一个异常
+	// 返回或者抛出之后任务组恢复到没有取消的状态，可以继续提交下一批子任务
+	void wait();
+
+	// 取消任务组，还没开始执行的子任务不再执行，已经在执行的子任务可以轮询CancellationToken::current()提前结束
+	void cancel();
+
+	bool isCancelled() const;
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+private:
+	ThreadPool& pool_;
+	std::shared_ptr<TaskGroupState> state_;
+};
+
 #endif // !THREADPOOL_H